@@ -0,0 +1,24 @@
+# flaskcpp_compile_templates(<target> <dir>)
+#
+# Compiles every <dir>/*.html into C++ render functions with flaskcpp_tc and adds
+# them to <target>. The generated templates are registered with TemplateEngine under
+# their file names; a template whose file is changed at runtime (hot reload) falls
+# back to the interpreter.
+function(flaskcpp_compile_templates target dir)
+    get_filename_component(dir "${dir}" ABSOLUTE)
+    file(GLOB templates CONFIGURE_DEPENDS "${dir}/*.html")
+    if(NOT templates)
+        message(WARNING "flaskcpp_compile_templates: no templates in ${dir}")
+        return()
+    endif()
+
+    set(output "${CMAKE_CURRENT_BINARY_DIR}/${target}_templates.cpp")
+    add_custom_command(
+        OUTPUT ${output}
+        COMMAND flaskcpp_tc -o ${output} ${templates}
+        DEPENDS flaskcpp_tc ${templates}
+        COMMENT "Compiling templates for ${target}"
+        VERBATIM
+    )
+    target_sources(${target} PRIVATE ${output})
+endfunction()
@@ -0,0 +1,161 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "HttpParser.h"
+#include "MultipartParser.h"
+#include "TimerWheel.h"
+#include "WebSocket.h"
+
+class EventLoop;
+
+// 客户端连接，空闲时由事件循环持有，收到完整请求后交给工作线程处理
+struct Connection {
+    int fd = -1;
+    std::string ip;
+    EventLoop* loop = nullptr;
+
+    std::string buffer;                     // 已读取但尚未处理的数据
+    HttpParser parser;                      // buffer中第一个请求的解析状态
+    std::unique_ptr<MultipartParser> multipart; // 流式接收的multipart主体，不在buffer中
+
+    size_t requestCount = 0;                // 该连接上已经处理的请求数
+    size_t bodyLimit = 0;                   // 当前请求主体的最大字节数，0表示不限制
+
+    std::atomic<bool> busy{false};          // 是否正在被工作线程处理
+    std::chrono::steady_clock::time_point lastActive;
+
+    // SSE 和 WebSocket：发送响应头后连接交给事件循环，以下字段只在事件循环线程中访问
+    bool sse = false;
+    std::string channel;
+    std::shared_ptr<WebSocket> websocket;
+    std::deque<std::shared_ptr<const std::string>> output; // 尚未发送的数据，缓冲区可以被多个连接共享
+    size_t outputOffset = 0;                // output.front() 中已发送的字节数
+    size_t outputBytes = 0;
+    bool closeAfterFlush = false;           // output 发送完后关闭连接
+    std::chrono::steady_clock::time_point lastWrite;
+};
+
+// 基于epoll的非阻塞事件循环（边沿触发 + EPOLLONESHOT）
+// 负责accept和读取请求，只有请求完整缓冲后才回调 onRequest
+class EventLoop {
+public:
+    using RequestCallback = std::function<void(std::shared_ptr<Connection>)>;
+    // 请求头解析完成后调用，返回非空时主体不再缓冲，而是边接收边写入解析器
+    using MultipartFactory = std::function<std::unique_ptr<MultipartParser>(const HttpParser&)>;
+    // 带主体的请求在请求头解析完成后调用，返回主体的最大字节数，0表示不限制
+    using BodyLimit = std::function<size_t(const HttpParser&)>;
+
+    // listenFd 必须是已经 listen 的非阻塞socket，由事件循环负责关闭
+    EventLoop(int listenFd, RequestCallback onRequest);
+    ~EventLoop();
+
+    // 运行事件循环，直到调用 stop()
+    void loop();
+
+    // 可在任意线程调用
+    void stop();
+
+    // 工作线程处理完成后关闭连接
+    void closeConnection(const std::shared_ptr<Connection>& conn);
+
+    // 工作线程处理完成后将持久连接交还给事件循环，等待下一个请求
+    void resume(const std::shared_ptr<Connection>& conn);
+
+    // 读取请求的超时时间（毫秒），超时未收到完整请求的连接会被关闭
+    void setRequestTimeout(size_t ms);
+
+    // 持久连接两次请求之间的空闲超时（毫秒）
+    void setIdleTimeout(size_t ms);
+
+    size_t getConnectionCount();
+
+    void setMultipartFactory(MultipartFactory factory);
+
+    // 主体超过限制时回复413并关闭连接；Expect: 100-continue 的请求在通过检查后才回复 100 Continue，
+    // 被拒绝的请求不会发送主体
+    void setBodyLimit(BodyLimit limit);
+
+    // 订阅频道：SSE 响应头已经发送，之后连接一直由事件循环负责，直到客户端断开。可在任意线程调用
+    void subscribe(const std::shared_ptr<Connection>& conn, const std::string& channel);
+
+    // 把序列化好的事件发送给订阅了 channel 的所有连接，可在任意线程调用。
+    // 写不完的部分按连接排队，等待socket可写，不占用工作线程
+    void publish(const std::string& channel, std::shared_ptr<const std::string> event);
+
+    // WebSocket 握手响应已经发送，之后连接由事件循环读写。可在任意线程调用
+    void upgrade(const std::shared_ptr<Connection>& conn, std::shared_ptr<WebSocket> websocket);
+
+    // 在事件循环线程中执行 task，可在任意线程调用
+    void post(std::function<void()> task);
+
+    // SSE 连接超过该时间（毫秒）没有数据时发送注释行作为心跳，WebSocket 连接发送 ping；0表示不发送
+    void setHeartbeatInterval(size_t ms);
+
+    // 单个 SSE/WebSocket 连接排队等待发送的最大字节数，超过时认为客户端太慢并断开
+    void setMaxPendingBytes(size_t bytes);
+
+    // 继续解析 conn.buffer 中的请求，流式主体会从 buffer 中取走
+    // 事件循环和处理pipelining的工作线程都通过它解析
+    HttpParser::State parseRequest(Connection& conn);
+
+private:
+    friend class WebSocket;
+
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> stopped{false};
+    RequestCallback onRequest;
+    MultipartFactory multipartFactory;
+    BodyLimit bodyLimit;
+    size_t requestTimeout = 5000;
+    size_t idleTimeout = 15000;
+
+    std::unordered_map<int, std::shared_ptr<Connection>> connections;
+    std::mutex connMutex;
+
+    std::chrono::steady_clock::time_point lastSweep;
+    int sweepInterval();
+
+    // 其他线程投递给事件循环线程执行的任务，通过 wakeFd 唤醒
+    std::vector<std::function<void()>> tasks;
+    std::mutex taskMutex;
+    void runTasks();
+
+    // SSE 订阅者、WebSocket 连接和心跳定时器，只在事件循环线程中访问
+    std::unordered_map<std::string, std::unordered_set<Connection*>> channels;
+    std::unordered_set<Connection*> websockets;
+    TimerWheel<std::weak_ptr<Connection>> heartbeats;
+    size_t heartbeatInterval = 15000;
+    size_t maxPendingBytes = 1024 * 1024;
+
+    void handleSSE(Connection* conn, uint32_t events);
+    void handleWebSocket(Connection* conn, uint32_t events);
+    // 发送或排队一段数据，连接需要关闭时返回false
+    bool sendBuffer(Connection* conn, const std::shared_ptr<const std::string>& data);
+    bool flushOutput(Connection* conn);
+    bool watchOutput(Connection* conn, bool writable);
+    // 关闭交给事件循环的连接（SSE 或 WebSocket）
+    void removeDetached(Connection* conn);
+    void sendHeartbeats();
+
+    // 请求头解析完成：检查主体大小、回复 100 Continue、创建multipart解析器；拒绝请求时返回false
+    bool onHeaders(Connection& conn, HttpParser::State state);
+    void acceptAll();
+    void readAll(Connection* conn);
+    void rearm(Connection* conn);
+    void sweepExpired();
+    void removeConnection(int fd);
+};
+
+#endif // EVENTLOOP_H
@@ -4,11 +4,17 @@
 
 #include "TemplateEngine.h"
 #include "ThreadPool.h" // Добавляем пул потоков
+#include "EventLoop.h"
+#include "RouteTree.h"
 #include "FlaskTypes.h"
 #include "./utils/file.h"
 #include "./utils/response.h"
+#include "./utils/responseWriter.h"
+#include "./utils/staticCache.h"
+#include "./utils/compress.h"
 #include "./utils/log.h"
 #include "./utils/urlSafeSerializer.h"
+#include <optional>
 
 
 #define FLASK_EMPTY_EXTRA_HEADER {"", ""}
@@ -21,11 +27,28 @@
 
 using UniteHandler = std::function<flaskcpp::Response(const RequestData&)>;
 
+// Server-Sent Events 路由：返回要订阅的频道，空字符串表示拒绝（404）
+using SSEHandler = std::function<std::string(const RequestData&)>;
+
+// WebSocket 路由的回调，都在事件循环线程中执行，见 WebSocket
+using WebSocketOpenHandler = std::function<void(const WebSocketPtr&, const RequestData&)>;
+using WebSocketMessageHandler = WebSocket::MessageHandler;
+using WebSocketCloseHandler = WebSocket::CloseHandler;
+
 // deprecated
 using SimpleHandler = std::function<std::string(const RequestData&)>;
 using ComplexHandler = std::function<std::string(const RequestData&)>;
 using FlaskFileHandler = std::function<flaskcpp::FileHandler(const RequestData&)>;
 
+// 单个路由的设置，见 route2()
+struct RouteOptions
+{
+    // RESP_TYPE_TEXT/RESP_TYPE_JSON 响应的压缩设置
+    flaskcpp::CompressionOptions compression;
+    // 请求主体的最大字节数，超过时回复413且不接收主体；0表示使用 setMaxBodySize() 的全局设置
+    size_t maxBodySize = 0;
+};
+
 std::vector<char> readFileBytesData(const std::string& file_path, bool verbose=false);
 
 void flaskSetDefaultVerbose(bool flag);
@@ -35,11 +58,15 @@ std::string parse_cookies(std::pair<std::string, std::string> pair, size_t secon
 class FlaskCpp {
 public:
 
-    FlaskCpp(std::string server_name, size_t minThreads=2, size_t maxThreads=128);
+    // acceptors: 监听socket（事件循环线程）的数量，大于1时使用SO_REUSEPORT，0表示每个CPU核心一个
+    FlaskCpp(std::string server_name, size_t minThreads=2, size_t maxThreads=128, size_t acceptors=1);
 
     // 更新后的构造函数，为线程池增加了额外参数， deprecated
     FlaskCpp(int port, bool verbose = false, bool enableHotReload = true, size_t minThreads = 2, size_t maxThreads = 8);
 
+    // runAsync() 启动的服务器没有调用 stop() 时在这里停止
+    ~FlaskCpp();
+
     void setTemplate(const std::string& name, const std::string& content);
 
     void setTemplateChangedCallback(TemplateEngine::FileChangedCallback callback);
@@ -50,12 +77,56 @@ public:
 
     void setCheckTaskDuration(size_t ms);
 
+    // 监听socket数量，见构造函数
+    void setAcceptors(size_t n);
+
+    // listen() 的backlog
+    void setBacklog(int backlog);
+
+    // 持久连接设置：空闲超时（毫秒，0表示关闭keep-alive）和单个连接的最大请求数
+    void setKeepAlive(size_t idle_timeout_ms, size_t max_requests=1000);
+
+    // multipart上传的文件边接收边写入该目录下的临时文件（默认系统临时目录）
+    void setUploadDir(const std::string& dir);
+
+    // 上传的文件交给 sink 处理而不是写入临时文件，此时 RequestData::File 只有文件信息
+    void setUploadSink(UploadSink sink);
+
+    // /static/ 文件缓存：内存预算、读入内存的文件大小上限（更大的文件使用mmap）、检查文件修改的间隔
+    void setStaticCache(size_t maxBytes, size_t smallFileLimit, int checkIntervalMs=1000);
+
+    flaskcpp::StaticCache::Stats staticCacheStats() const;
+
     void addCheckTask(TemplateEngine::CheckTask task);
 
     void log(const flaskcpp::LogMsg& msg);
 
+    // 所有添加路由的函数在参数个数超过 RouteTree::MAX_PARAMS 时记录错误并抛出 std::invalid_argument
     void route2(const std::string& path, UniteHandler handler);
 
+    // 使用单独设置的路由；没有设置的路由使用 setCompression() 的全局设置
+    void route2(const std::string& path, UniteHandler handler, const RouteOptions& options);
+
+    // 全局压缩设置，用于 /static/ 文件、send_file 和没有单独设置的路由；level 为0时关闭压缩
+    void setCompression(const flaskcpp::CompressionOptions& options);
+
+    // 全局请求主体大小限制（字节），用于没有单独设置的路由；0表示不限制
+    void setMaxBodySize(size_t bytes);
+
+    // Server-Sent Events 路由：发送响应头后连接保持打开，由事件循环推送 publish() 的事件，不占用工作线程
+    void routeSSE(const std::string& path, SSEHandler handler);
+
+    // 向频道的所有订阅者发送一个事件，事件只序列化一次；可在任意线程调用
+    void publish(const std::string& channel, const std::string& data, const std::string& event="");
+
+    // SSE 连接的心跳间隔（毫秒），0表示不发送心跳；需在 run() 之前设置
+    // WebSocket 连接使用同一个间隔发送 ping，两个间隔内没有收到数据的连接会被关闭
+    void setSSEHeartbeat(size_t ms);
+
+    // WebSocket 路由（RFC 6455）：握手后连接由事件循环读写，不占用工作线程
+    void routeWebSocket(const std::string& path, WebSocketOpenHandler on_open,
+                        WebSocketMessageHandler on_message, WebSocketCloseHandler on_close = nullptr);
+
     // 添加无参数路由, deprecated
     void route(const std::string& path, SimpleHandler handler) [[deprecated]];
 
@@ -83,6 +154,10 @@ public:
 
     std::string renderTemplate(const std::string& templateName, const TemplateEngine::Context& context);
 
+    // 流式渲染模板，渲染的同时以 chunked 编码发送；模板不存在时返回的 Response.type 为 RESP_TYPE_UNDEFINED
+    flaskcpp::Response streamTemplate(const std::string& templateName, TemplateEngine::Context context,
+                                      std::vector<std::pair<std::string, std::string>> extra_headers = {});
+
     template <typename T>
     std::string send_file(std::vector<T> file_data, std::string file_name="", bool as_attachment=false,
                           const std::vector<std::pair<std::string, std::string>>& extra_headers = {});
@@ -149,43 +224,102 @@ private:
 
     std::atomic<bool> bind_success = true;
 
+    size_t acceptors = 1;
+    int backlog = SOMAXCONN;
+
+    size_t keepAliveTimeout = 15000;
+    size_t maxKeepAliveRequests = 1000;
+
+    std::string uploadDir;
+
+    flaskcpp::StaticCache staticCache;
+    flaskcpp::CompressionOptions compression;
+    size_t maxBodySize = 0;
+    size_t sseHeartbeat = 15000;
+    UploadSink uploadSink = nullptr;
+
     TemplateEngine::FileChangedCallback template_changed_callback=nullptr;
 
+    // 事件循环，需在线程池之后析构
+    std::vector<std::unique_ptr<EventLoop>> eventLoops;
+    std::mutex loopMutex;
+
     // thread pool
     ThreadPool threadPool;
 
+    // runAsync() 的事件循环在独立线程中运行，不占用线程池的工作线程：
+    // 工作线程的本地队列只有它自己取任务，事件循环阻塞在 epoll_wait 中时分发的请求只能被窃取
+    std::thread serverThread;
+
     // hot reload
     std::thread hotReloadThread;
 
     void monitorTemplates();
 
     
-    struct UnitedParamRoute {
-        std::string pattern;
+    struct UniteRoute {
         UniteHandler handler;
+        std::optional<RouteOptions> options;
     };
-    std::unordered_map<std::string, UniteHandler> ROUTES;
-    std::vector<UnitedParamRoute> paramROUTES;
 
-    // deprecated
-    struct ParamRoute {
-        std::string pattern;
-        ComplexHandler handler;
+    struct WebSocketRoute {
+        WebSocketOpenHandler onOpen;
+        WebSocketMessageHandler onMessage;
+        WebSocketCloseHandler onClose;
     };
-    std::unordered_map<std::string, ComplexHandler> routes;
-    std::unordered_map<std::string, FlaskFileHandler> file_routes;
-    std::vector<ParamRoute> paramRoutes;
-
 
-    std::mutex routeMutex;
+    // 路由表快照，发布后不再修改
+    struct RouteTable {
+        // 路由前缀树，静态路由和带参数的路由都在其中
+        RouteTree<UniteRoute> ROUTES;
+        RouteTree<SSEHandler> SSE_ROUTES;
+        RouteTree<WebSocketRoute> WS_ROUTES;
 
-    void handleClient(int clientSocket, const std::string& clientIP);
-    std::string readRequest(int clientSocket);
-    void parseRequest(const std::string& request, RequestData& reqData);
+        // deprecated
+        RouteTree<ComplexHandler> routes;
+        std::unordered_map<std::string, FlaskFileHandler> file_routes;
+    };
+    // 添加路由时复制一份修改后替换（RCU），并把 routeGeneration 设为新的代数。
+    // 每个线程缓存自己的快照，代数没有变化时直接使用，请求处理不加锁也不修改引用计数；
+    // 旧快照在所有线程都换成新快照后释放
+    std::shared_ptr<const RouteTable> routeTable = std::make_shared<RouteTable>();
+    std::atomic<uint64_t> routeGeneration{0};
+    std::mutex routeMutex;  // 保护 routeTable，只在添加路由和线程刷新缓存时使用
+
+    // 当前线程缓存的路由表快照，在当前线程下一次调用之前有效
+    const RouteTable& routes();
+    void updateRoutes(const std::function<void(RouteTable&)>& update);
+    // RouteTree::insert 失败（参数过多）时记录错误并抛出，路由表不会被替换
+    void checkInserted(bool inserted, const std::string& path);
+    void addUniteRoute(const std::string& path, UniteRoute route);
+
+    int createListenSocket(bool reusePort);
+    void handleClient(std::shared_ptr<Connection> conn);
+    bool handleRequest(const std::shared_ptr<Connection>& conn);
+    // 检查握手请求并回复101，成功后连接交给事件循环
+    void upgradeWebSocket(const std::shared_ptr<Connection>& conn, const WebSocketRoute& route,
+                          RequestData& reqData, int& status);
+    bool isKeepAlive(const HttpParser& parser, size_t served);
+    // 只填充 method、path 和查询参数
+    void parseRequestLine(const HttpParser& parser, RequestData& reqData);
+    // 填充请求头、主体、表单、cookies 和 session
+    void parseRequest(const HttpParser& parser, MultipartParser* multipart, RequestData& reqData);
     void parseQueryString(const std::string& queryString, std::map<std::string, std::string>& queryParams);
-    bool matchParamRoute(const std::string& path, const std::string& pattern, std::map<std::string,std::string>& routeParams);
-    bool serveStaticFile(const RequestData& reqData, std::string& response);
-    void sendResponse(int clientSocket, const std::string& content);
+    // 静态文件从 staticCache 取得，PHP 的输出写入 response
+    bool serveStaticFile(const RequestData& reqData, std::string_view acceptEncoding,
+                         std::string& response, flaskcpp::StaticCache::EntryPtr& file);
+    // 把响应头（插入 Connection 字段）加入 chain，主体由调用者继续加入；
+    // keepAlive 按响应头更新，content 在发送完成前必须保持有效；
+    // headOnly（HEAD 请求）时只加入响应头，Content-Length 保持不变
+    void appendResponse(const std::string& content, bool& keepAlive, flaskcpp::ResponseChain& chain,
+                        bool headOnly=false);
+    // 返回连接是否可以继续保持
+    bool sendResponse(int clientSocket, const std::string& content, bool keepAlive=false, bool headOnly=false);
+    bool sendResponse(int clientSocket, const std::string& header, const std::string& body, bool keepAlive,
+                      bool headOnly=false);
+    // 发送 RESP_TYPE_STREAM 响应；chunked 为false时（HTTP/1.0）主体直接发送并关闭连接；headOnly 时不调用生成函数
+    bool sendStream(int clientSocket, const flaskcpp::Response& resp, bool chunked, bool keepAlive,
+                    bool headOnly=false);
     
 
     void parseCookies(const std::string& cookieHeader, std::map<std::string, std::string>& cookies);
@@ -27,6 +27,13 @@
 // #include <pair>
 #include "./utils/parse/json.hpp"
 
+// 上传的临时文件，最后一个引用释放时关闭并删除（已被 save_file 移走的除外）
+struct TempFile {
+    std::string path;
+    int fd = -1;
+    ~TempFile();
+};
+
 // Структура для хранения данных запроса
 struct RequestData {
     std::string method;
@@ -42,7 +49,10 @@ struct RequestData {
         std::string name;
         std::string file_name;
         std::string type;
-        std::vector<char> data;
+        size_t size = 0;
+        std::string path;               // 临时文件路径，由 UploadSink 接收时为空
+        int fd = -1;                    // 临时文件描述符（读写，位置在文件开头）
+        std::shared_ptr<TempFile> temp;
     };
     nlohmann::json json;
     std::map<std::string, File> files;
@@ -50,6 +60,9 @@ struct RequestData {
     std::map<std::string, std::string> session;
 };
 
+// 上传文件的数据接收回调，代替临时文件。data 为 nullptr 表示该文件结束，返回 false 中止上传
+using UploadSink = std::function<bool(const RequestData::File& file, const char* data, size_t size)>;
+
 enum FlaskFileType
 {
     FLASK_FILE_AUTO=-1,
@@ -0,0 +1,120 @@
+#ifndef HTTPPARSER_H
+#define HTTPPARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// 增量式HTTP请求解析器（状态机）
+// 直接在socket读缓冲区上解析，不复制数据；缓冲区增长后可以继续调用 parse()，
+// 已经解析过的部分不会重新扫描。解析结果以 std::string_view 的形式返回，
+// 指向最近一次 parse() 传入的缓冲区，缓冲区被修改后失效。
+// Transfer-Encoding: chunked 的主体在缓冲区中原地解码（删除块头），解码后与 Content-Length 的主体相同。
+class HttpParser {
+public:
+    enum State {
+        STATE_REQUEST_LINE,
+        STATE_HEADERS,
+        STATE_BODY,
+        STATE_COMPLETE,
+        STATE_ERROR
+    };
+
+    // 解析 buffer，buffer 必须以上次传入的内容为前缀（chunked 主体的块头由解析器删除）
+    State parse(std::string& buffer);
+
+    // 开始解析下一个请求（已处理的请求已从缓冲区删除后调用）
+    void reset();
+
+    State state() const { return state_; }
+    bool complete() const { return state_ == STATE_COMPLETE; }
+
+    // 完整请求（请求行 + 头 + 主体）在缓冲区中占用的字节数，已取走的主体不计算在内
+    // chunked 主体只计算已经解码的部分；主体尚未到达时可能超出 SIZE_MAX，此时返回 SIZE_MAX
+    size_t messageSize() const
+    {
+        size_t remaining = bodyRemaining();
+        return remaining > SIZE_MAX - bodyStart_ ? SIZE_MAX : bodyStart_ + remaining;
+    }
+
+    // 主体在缓冲区中的起始位置
+    size_t bodyStart() const { return bodyStart_; }
+
+    // 尚未到达或仍在缓冲区中的主体字节数；chunked 主体为已解码、仍在缓冲区中的字节数
+    size_t bodyRemaining() const { return contentLength_ - bodyConsumed_; }
+
+    // 调用者已经从缓冲区的 bodyStart() 处取走 n 字节主体（流式处理），之后需重新调用 parse()
+    void consumeBody(size_t n) { bodyConsumed_ += n; }
+
+    std::string_view method() const { return view(method_); }
+    std::string_view target() const { return view(target_); }      // 路径 + 查询字符串
+    std::string_view path() const;                                  // 不含查询字符串
+    std::string_view query() const;                                 // '?' 之后的部分
+    std::string_view version() const { return view(version_); }
+    std::string_view body() const { return std::string_view(data_ + bodyStart_, bodyRemaining()); }
+
+    size_t headerCount() const { return headers_.size(); }
+    std::string_view headerName(size_t i) const { return view(headers_[i].name); }
+    std::string_view headerValue(size_t i) const { return view(headers_[i].value); }
+
+    // 按名称查找头（不区分大小写），不存在时返回空
+    std::string_view header(std::string_view name) const;
+    bool hasHeader(std::string_view name) const;
+
+    // chunked 主体为目前已经解码的长度
+    size_t contentLength() const { return contentLength_; }
+
+    bool chunked() const { return chunked_; }
+    // 请求同时带有 Transfer-Encoding 和 Content-Length，响应之后必须关闭连接
+    bool mustClose() const { return mustClose_; }
+    // 请求带有主体（Content-Length 大于0或者 chunked）
+    bool hasBody() const { return chunked_ || contentLength_ > 0; }
+
+    // 请求头的最大长度
+    static const size_t MAX_HEADER_SIZE = 64 * 1024;
+    // 块头（长度和扩展）以及 trailer 单行的最大长度
+    static const size_t MAX_CHUNK_LINE = 4 * 1024;
+
+private:
+    struct Slice {
+        size_t pos = 0;
+        size_t len = 0;
+    };
+    struct HeaderSlice {
+        Slice name;
+        Slice value;
+    };
+
+    State state_ = STATE_REQUEST_LINE;
+    const char* data_ = nullptr;
+    size_t pos_ = 0;                // 下一个待扫描的位置
+    size_t bodyStart_ = 0;
+    size_t contentLength_ = 0;
+    size_t bodyConsumed_ = 0;
+
+    enum ChunkState {
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        CHUNK_TRAILER
+    };
+    bool chunked_ = false;
+    bool mustClose_ = false;
+    ChunkState chunkState_ = CHUNK_SIZE;
+    size_t chunkRemaining_ = 0;     // 当前块尚未到达的字节数
+
+    Slice method_, target_, version_;
+    std::vector<HeaderSlice> headers_;
+
+    std::string_view view(const Slice& s) const { return std::string_view(data_ + s.pos, s.len); }
+
+    bool parseRequestLine(size_t lineEnd);
+    bool parseHeaderLine(size_t lineEnd);
+    bool onHeadersComplete();
+    State parseChunked(std::string& buffer);
+};
+
+bool strEqualsIgnoreCase(std::string_view a, std::string_view b);
+
+#endif // HTTPPARSER_H
@@ -0,0 +1,65 @@
+#ifndef MULTIPARTPARSER_H
+#define MULTIPARTPARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include "FlaskTypes.h"
+
+// 流式 multipart/form-data 解析器
+// 主体按到达顺序分段写入，边接收边查找分隔符；文件部分直接写入临时文件
+// （或交给 UploadSink），普通字段保存在内存中，整个主体不会被缓冲。
+class MultipartParser {
+public:
+    // uploadDir 为空时使用系统临时目录；sink 不为空时文件数据交给 sink 而不是写入临时文件
+    MultipartParser(std::string boundary, std::string uploadDir = "", UploadSink sink = nullptr);
+
+    // 写入下一段主体数据，格式错误或写文件失败时返回 false
+    bool write(const char* data, size_t size);
+
+    // 是否已经读到结束分隔符
+    bool finished() const { return state_ == STATE_DONE; }
+
+    // 解析结果，文件以 file_name 为键
+    std::map<std::string, RequestData::File>& files() { return files_; }
+    std::map<std::string, std::string>& fields() { return fields_; }
+
+    // 从 Content-Type 中取出 boundary，不是 multipart/form-data 时返回空
+    static std::string boundaryOf(std::string_view contentType);
+
+    // 普通字段和部分头的最大长度
+    static const size_t MAX_FIELD_SIZE = 1024 * 1024;
+    static const size_t MAX_PART_HEADER_SIZE = 16 * 1024;
+
+private:
+    enum State {
+        STATE_PREAMBLE,
+        STATE_DELIMITER,            // 分隔符之后，等待 "\r\n" 或 "--"
+        STATE_HEADERS,
+        STATE_DATA,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    State state_ = STATE_PREAMBLE;
+    std::string delimiter_;         // "\r\n--" + boundary
+    std::string uploadDir_;
+    UploadSink sink_;
+    std::string pending_;           // 还不能确定是否属于分隔符的数据
+
+    // 当前部分
+    RequestData::File part_;
+    bool isFile_ = false;
+    std::string value_;
+
+    std::map<std::string, RequestData::File> files_;
+    std::map<std::string, std::string> fields_;
+
+    bool parsePartHeaders(std::string_view headers);
+    bool beginPart();
+    bool appendPart(const char* data, size_t size);
+    bool endPart();
+};
+
+#endif // MULTIPARTPARSER_H
@@ -0,0 +1,177 @@
+#ifndef ROUTETREE_H
+#define ROUTETREE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <array>
+#include <memory>
+#include <algorithm>
+
+// 按路径段组织的前缀树路由
+// 支持静态段、<param>（匹配一段）和 <path:param>（最后一段，匹配剩余路径）。
+// 匹配时按段逐层查找，优先级：静态段 > <param> > <path:param>，失败时回溯。
+// 匹配过程不分配内存，只有匹配成功后才写入 routeParams。
+template <typename Handler>
+class RouteTree {
+public:
+    // 单个路由最多的参数个数
+    static const size_t MAX_PARAMS = 16;
+
+    RouteTree() {}
+    RouteTree(const RouteTree& other) : size_(other.size_) { copyNode(root_, other.root_); }
+    RouteTree& operator=(const RouteTree& other)
+    {
+        if (this != &other) {
+            root_ = Node();
+            copyNode(root_, other.root_);
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    // 添加路由，相同的pattern会覆盖之前的处理函数；参数过多时返回false
+    bool insert(const std::string& pattern, Handler handler)
+    {
+        Node* node = &root_;
+        std::vector<std::string> names;
+        std::string_view p = pattern;
+        size_t pos = 0;
+        while (nextSegment(p, pos)) {
+            size_t end = p.find('/', pos);
+            if (end == std::string_view::npos) end = p.size();
+            std::string_view seg = p.substr(pos, end - pos);
+            pos = end;
+
+            bool last = !nextSegment(p, end);
+            if (last && seg.size() > 7 && seg.compare(0, 6, "<path:") == 0 && seg.back() == '>') {
+                names.emplace_back(seg.substr(6, seg.size() - 7));
+                if (!node->wildcard) node->wildcard.reset(new Node());
+                node = node->wildcard.get();
+            }
+            else if (seg.size() > 2 && seg.front() == '<' && seg.back() == '>') {
+                names.emplace_back(seg.substr(1, seg.size() - 2));
+                if (!node->param) node->param.reset(new Node());
+                node = node->param.get();
+            }
+            else {
+                auto it = std::lower_bound(node->children.begin(), node->children.end(), seg,
+                    [](const Child& c, std::string_view s) { return std::string_view(c.first) < s; });
+                if (it == node->children.end() || it->first != seg) {
+                    it = node->children.emplace(it, std::string(seg), std::unique_ptr<Node>(new Node()));
+                }
+                node = it->second.get();
+            }
+        }
+        if (names.size() > MAX_PARAMS) return false;
+
+        if (!node->terminal) ++size_;
+        node->terminal = true;
+        node->handler = std::move(handler);
+        node->paramNames = std::move(names);
+        return true;
+    }
+
+    // 查找路由，未找到返回 nullptr
+    const Handler* match(std::string_view path, std::map<std::string, std::string>& routeParams) const
+    {
+        std::array<std::string_view, MAX_PARAMS> values;
+        const Node* node = matchNode(&root_, path, 0, values, 0);
+        if (!node) return nullptr;
+        for (size_t i = 0; i < node->paramNames.size(); ++i) {
+            routeParams[node->paramNames[i]] = std::string(values[i]);
+        }
+        return &node->handler;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    struct Node;
+    using Child = std::pair<std::string, std::unique_ptr<Node>>;
+
+    struct Node {
+        std::vector<Child> children;        // 静态段，按名称排序
+        std::unique_ptr<Node> param;        // <param>
+        std::unique_ptr<Node> wildcard;     // <path:param>
+        bool terminal = false;
+        Handler handler;
+        std::vector<std::string> paramNames;
+    };
+
+    Node root_;
+    size_t size_ = 0;
+
+    // 深拷贝，用于在副本上添加路由（写时复制）
+    static void copyNode(Node& dst, const Node& src)
+    {
+        dst.terminal = src.terminal;
+        dst.handler = src.handler;
+        dst.paramNames = src.paramNames;
+        dst.children.reserve(src.children.size());
+        for (const auto& c: src.children) {
+            dst.children.emplace_back(c.first, std::unique_ptr<Node>(new Node()));
+            copyNode(*dst.children.back().second, *c.second);
+        }
+        if (src.param) {
+            dst.param.reset(new Node());
+            copyNode(*dst.param, *src.param);
+        }
+        if (src.wildcard) {
+            dst.wildcard.reset(new Node());
+            copyNode(*dst.wildcard, *src.wildcard);
+        }
+    }
+
+    // 跳过连续的 '/'，还有路径段时返回true
+    static bool nextSegment(std::string_view path, size_t& pos)
+    {
+        while (pos < path.size() && path[pos] == '/') ++pos;
+        return pos < path.size();
+    }
+
+    static const Node* matchNode(const Node* node, std::string_view path, size_t pos,
+                                 std::array<std::string_view, MAX_PARAMS>& values, size_t depth)
+    {
+        if (!nextSegment(path, pos)) {
+            if (node->terminal) return node;
+            // <path:param> 可以匹配空路径
+            if (node->wildcard && node->wildcard->terminal) {
+                values[depth] = std::string_view();
+                return node->wildcard.get();
+            }
+            return nullptr;
+        }
+
+        size_t end = path.find('/', pos);
+        if (end == std::string_view::npos) end = path.size();
+        std::string_view seg = path.substr(pos, end - pos);
+
+        auto it = std::lower_bound(node->children.begin(), node->children.end(), seg,
+            [](const Child& c, std::string_view s) { return std::string_view(c.first) < s; });
+        if (it != node->children.end() && it->first == seg) {
+            const Node* found = matchNode(it->second.get(), path, end, values, depth);
+            if (found) return found;
+        }
+
+        if (depth >= MAX_PARAMS) return nullptr;
+
+        if (node->param) {
+            values[depth] = seg;
+            const Node* found = matchNode(node->param.get(), path, end, values, depth + 1);
+            if (found) return found;
+        }
+
+        if (node->wildcard && node->wildcard->terminal) {
+            std::string_view rest = path.substr(pos);
+            while (!rest.empty() && rest.back() == '/') rest.remove_suffix(1);
+            values[depth] = rest;
+            return node->wildcard.get();
+        }
+        return nullptr;
+    }
+};
+
+#endif // ROUTETREE_H
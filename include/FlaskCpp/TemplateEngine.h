@@ -5,7 +5,9 @@
 #include <map>
 #include <variant>
 #include <vector>
-#include <regex>
+#include <memory>
+#include <list>
+#include <atomic>
 #include <unordered_map>
 #include <functional>
 #include <mutex>
@@ -21,6 +23,42 @@ public:
 
     using FileChangedCallback = std::function<void(const std::string&)>;
     using CheckTask = std::function<void()>;
+    // Получатель потокового рендера; false — прекратить рендер (например, клиент отключился)
+    using OutputSink = std::function<bool(const char* data, size_t size)>;
+
+    // Шаблоны, заранее скомпилированные в C++ (flaskcpp_tc, flaskcpp_compile_templates в CMake)
+    class RenderContext;
+    using CompiledRender = void (*)(RenderContext& ctx);
+
+    // Узел скомпилированного шаблона
+    struct Node {
+        enum Type { TEXT, VAR, IF, FOR, INCLUDE, BLOCK };
+        enum Filter { NONE, UPPER, LOWER, ESCAPE };
+
+        Type type = TEXT;
+        std::string text;               // TEXT: текст; VAR/IF: имя переменной; FOR: имя списка; INCLUDE/BLOCK: имя
+        std::string loopVar;            // FOR: переменная цикла
+        Filter filter = NONE;           // VAR: фильтр
+        std::vector<Node> children;     // IF: ветка then; FOR: тело цикла; BLOCK: содержимое по умолчанию
+        std::vector<Node> elseChildren; // IF: ветка else
+    };
+
+    // Шаблон, разобранный один раз при setTemplate
+    struct Program {
+        std::string source;
+        std::string extends;                           // имя базового шаблона для {% extends %}
+        std::vector<Node> nodes;
+        std::map<std::string, const Node*> blocks;     // {% block %} шаблона, указывают в nodes
+        std::vector<std::string> variables;            // переменные, которые читает шаблон
+        std::vector<std::string> includes;             // шаблоны из {% include %}
+        uint64_t generation = 0;                       // меняется при каждом setTemplate
+        CompiledRender compiled = nullptr;             // сгенерированная функция рендера, если есть
+    };
+
+    TemplateEngine();
+
+    // Разбор шаблона в дерево узлов
+    static std::shared_ptr<Program> compile(const std::string& content);
 
     // Установка шаблона по имени
     void setTemplate(const std::string& name, const std::string& content);
@@ -30,6 +68,13 @@ public:
     // Рендер шаблона
     std::string render(const std::string& templateName, const Context& context) const;
 
+    // Потоковый рендер: готовые куски размером около chunkSize сразу передаются в sink.
+    // Возвращает false, если шаблон не найден или sink прервал рендер
+    bool render(const std::string& templateName, const Context& context,
+                const OutputSink& sink, size_t chunkSize = 16 * 1024) const;
+
+    bool hasTemplate(const std::string& templateName) const;
+
     void addConfigUpdateListener(const std::string& config_path, FileChangedCallback callback);
 
     void addCheckTask(CheckTask task);
@@ -39,6 +84,15 @@ public:
 
     void checkConfigOnce();
 
+    // Ограничения кэша включений: число записей и суммарный размер в байтах
+    void setIncludeCacheLimits(size_t maxEntries, size_t maxBytes);
+
+    // Регистрирует сгенерированную функцию рендера (вызывается из сгенерированного кода
+    // при статической инициализации). Функция используется, пока setTemplate получает
+    // тот же исходный текст; изменённый шаблон (горячая перезагрузка) рендерится интерпретатором.
+    // Новые экземпляры TemplateEngine сразу содержат все зарегистрированные шаблоны.
+    static bool registerCompiled(const char* name, const char* source, size_t size, CompiledRender render);
+
 private:
     size_t duration=500;
     struct ConfigListenerCtx
@@ -46,52 +100,121 @@ private:
         FileChangedCallback callback=nullptr;
         std::filesystem::file_time_type update_time;
     };
-    std::map<std::string, std::string> templates;
+    std::map<std::string, std::shared_ptr<const Program>> templates;
+    mutable std::mutex templateMutex; // setTemplate вызывается из потока проверки файлов
     std::map<std::string, ConfigListenerCtx> config_listeners;
     std::vector<CheckTask> checkTasks;
 
-    std::string getTemplateContent(const std::string& name) const;
+    // Переопределённые блоки при рендере шаблона с extends
+    using BlockMap = std::map<std::string, const Node*>;
+
+    // Область видимости при рендере. Корневая ссылается на Context, каждая итерация
+    // {% for %} добавляет кадр с переменной цикла и текущим элементом списка —
+    // контекст при этом не копируется.
+    struct Scope {
+        const Context* context = nullptr;              // только у корневой области
+        const Scope* parent = nullptr;
+        const std::string* loopVar = nullptr;
+        const std::map<std::string, std::string>* item = nullptr;
+    };
 
-    // Рендер всего шаблона: обрабатываем extends, comments, include, if, for и переменные
-    std::string renderTemplateContent(const std::string& content, const Context& context) const;
+    // Результат поиска переменной: значение из Context или поле элемента цикла
+    struct ValueRef {
+        const ValueType* value = nullptr;
+        const std::string* field = nullptr;
+        explicit operator bool() const { return value || field; }
+    };
+
+    // Буфер рендера; при потоковом рендере заполненный буфер сразу отдаётся в sink
+    struct Output {
+        std::string buffer;
+        const OutputSink* sink = nullptr;
+        size_t chunkSize = 0;
+        bool failed = false;
+
+        void flush()
+        {
+            if (!sink || failed || buffer.empty()) return;
+            if (!(*sink)(buffer.data(), buffer.size())) failed = true;
+            buffer.clear();
+        }
+    };
+
+    std::shared_ptr<const Program> findTemplate(const std::string& name) const;
+
+    // Рендер шаблона с учётом extends
+    void renderProgram(const std::shared_ptr<const Program>& program, const Scope& scope, Output& output) const;
+    void renderNodes(const std::vector<Node>& nodes, const Scope& scope, const BlockMap& blocks, Output& output) const;
 
     // Вспомогательные функции
-    bool evaluateCondition(const std::string& varName, const Context& context) const;
-    std::string replaceVariables(const std::string& str, const Context& context) const;
-    void renderLoop(const std::string& loopVar, const std::string& listName, const std::string& innerBlock, const Context& context, std::string& output) const;
-    std::string processIf(const std::string& block, const Context& context) const;
-    std::string processFor(const std::string& block, const Context& context) const;
-    std::string processInclude(const std::string& block, const Context& context) const;
-    std::string processExtends(const std::string& content, const Context& context, std::map<std::string, std::string>& childBlocks) const;
-    std::map<std::string, std::string> extractBlocks(const std::string& content) const;
-    std::string applyFilters(const std::string& value, const std::string& filter) const;
-    std::string trim(const std::string& s) const;
-
-    // Обработка комментариев
-    std::string processComments(const std::string& content) const;
-
-    // Кэширование включений
+    ValueRef lookup(const std::string& varName, const Scope& scope) const;
+    bool evaluateCondition(const std::string& varName, const Scope& scope) const;
+    void renderVariable(const std::string& varName, Node::Filter filter, const Scope& scope, std::string& output) const;
+    void renderLoop(const Node& node, const Scope& scope, const BlockMap& blocks, Output& output) const;
+    void renderInclude(const std::string& includeName, const Scope& scope, std::string& output) const;
+    static void applyFilter(const std::string& value, Node::Filter filter, std::string& output);
+
+    // Кэширование включений (LRU).
+    // Ключ — имя шаблона, поколения всех шаблонов, от которых зависит результат,
+    // и хэш только тех переменных, которые эти шаблоны читают.
     struct IncludeCacheKey {
         std::string includeName;
-        size_t contextHash;
+        size_t dependencyHash;
 
         bool operator==(const IncludeCacheKey& other) const {
-            return includeName == other.includeName && contextHash == other.contextHash;
+            return includeName == other.includeName && dependencyHash == other.dependencyHash;
         }
     };
 
     // Хэш-функция для IncludeCacheKey
     struct IncludeCacheKeyHash {
         std::size_t operator()(const IncludeCacheKey& key) const {
-            return std::hash<std::string>()(key.includeName) ^ (std::hash<size_t>()(key.contextHash) << 1);
+            return std::hash<std::string>()(key.includeName) ^ (std::hash<size_t>()(key.dependencyHash) << 1);
         }
     };
 
-    mutable std::unordered_map<IncludeCacheKey, std::string, IncludeCacheKeyHash> includeCache;
+    using IncludeCacheEntry = std::pair<IncludeCacheKey, std::string>;
+
+    mutable std::list<IncludeCacheEntry> includeLru; // в начале — недавно использованные
+    mutable std::unordered_map<IncludeCacheKey, std::list<IncludeCacheEntry>::iterator, IncludeCacheKeyHash> includeCache;
+    mutable size_t includeCacheBytes = 0;
+    size_t includeCacheMaxEntries = 1024;
+    size_t includeCacheMaxBytes = 8 * 1024 * 1024;
     mutable std::mutex cacheMutex; // Для потокобезопасности
 
-    // Функция для хэширования контекста
-    size_t hashContext(const Context& context) const;
+    std::atomic<uint64_t> nextGeneration{1};
+
+    // Хэш поколений шаблона (включая include и extends) и значений его переменных
+    void hashDependencies(const Program& program, const Scope& scope, size_t& seed, size_t depth) const;
+    void evictIncludes() const;
+
+public:
+    // Интерфейс для сгенерированных функций рендера
+    class RenderContext {
+    public:
+        void text(const char* data, size_t size);
+        void variable(const std::string& name, Node::Filter filter);
+        bool condition(const std::string& name);
+        void loop(const std::string& list, const std::string& loopVar, CompiledRender body);
+        void include(const std::string& name);
+        // Блок по умолчанию; при extends используется переопределение из дочернего шаблона
+        void block(const std::string& name, CompiledRender body);
+
+    private:
+        friend class TemplateEngine;
+        RenderContext(const TemplateEngine& engine, const Scope& scope, const BlockMap& blocks, Output& output)
+            : engine(engine), scope(scope), blocks(blocks), output(output) {}
+
+        void checkFlush()
+        {
+            if (output.sink && output.buffer.size() >= output.chunkSize) output.flush();
+        }
+
+        const TemplateEngine& engine;
+        const Scope& scope;
+        const BlockMap& blocks;
+        Output& output;
+    };
 };
 
 #endif // TEMPLATEENGINE_H
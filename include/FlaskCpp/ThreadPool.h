@@ -2,35 +2,135 @@
 #define THREADPOOL_H
 
 #include <vector>
+#include <deque>
 #include <thread>
-#include <queue>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
 #include <future>
 #include <atomic>
 #include <chrono>
+#include <memory>
 #include <iostream> // Для std::cout и std::endl
+#include <type_traits>
+#include <cstddef>
+#include "WorkQueue.h"
+
+// Перемещаемая обёртка задачи с буфером для небольших callable-объектов (small buffer).
+// Лямбды с захватом до INLINE_SIZE байт хранятся внутри объекта без выделения памяти,
+// более крупные — в куче.
+class InlineTask {
+public:
+    static const size_t INLINE_SIZE = 48;
+
+    InlineTask() {}
+
+    template<class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, InlineTask>::value>::type>
+    InlineTask(F&& f)
+    {
+        using Fn = typename std::decay<F>::type;
+        if constexpr (fitsInline<Fn>()) {
+            new (storage) Fn(std::forward<F>(f));
+            ops = &inlineOps<Fn>;
+        }
+        else {
+            *reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(f));
+            ops = &heapOps<Fn>;
+        }
+    }
+
+    InlineTask(InlineTask&& other) noexcept
+    {
+        moveFrom(other);
+    }
+
+    InlineTask& operator=(InlineTask&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    ~InlineTask() { reset(); }
+
+    void operator()() { ops->invoke(storage); }
 
-// Структура для задач с приоритетом
-struct PrioritizedTask {
-    int priority; // Чем меньше число, тем выше приоритет
-    std::function<void()> task;
-    
-    bool operator<(const PrioritizedTask& other) const {
-        // Для priority_queue, которая по умолчанию максимальная, инвертируем сравнение
-        return priority > other.priority;
+    explicit operator bool() const { return ops != nullptr; }
+
+    void reset()
+    {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
     }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* from, void* to);   // перемещает и уничтожает источник
+        void (*destroy)(void* storage);
+    };
+
+    template<class Fn>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    template<class Fn>
+    static inline const Ops inlineOps = {
+        [](void* s) { (*static_cast<Fn*>(s))(); },
+        [](void* from, void* to) {
+            new (to) Fn(std::move(*static_cast<Fn*>(from)));
+            static_cast<Fn*>(from)->~Fn();
+        },
+        [](void* s) { static_cast<Fn*>(s)->~Fn(); }
+    };
+
+    template<class Fn>
+    static inline const Ops heapOps = {
+        [](void* s) { (**static_cast<Fn**>(s))(); },
+        [](void* from, void* to) { *static_cast<Fn**>(to) = *static_cast<Fn**>(from); },
+        [](void* s) { delete *static_cast<Fn**>(s); }
+    };
+
+    void moveFrom(InlineTask& other)
+    {
+        if (other.ops) {
+            other.ops->move(other.storage, storage);
+            ops = other.ops;
+            other.ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+    const Ops* ops = nullptr;
 };
 
+// Пул потоков с перехватом задач (work stealing).
+// У каждого рабочего потока свои lock-free деки, задачи из внешних потоков попадают
+// в глобальную очередь. Приоритеты отображаются на фиксированное число полос (lanes):
+// задачи из полосы с меньшим номером всегда берутся первыми.
 class ThreadPool {
 public:
+    // Количество полос приоритета; priority <= 0 — полоса 0, priority >= NUM_LANES-1 — последняя
+    static const int NUM_LANES = 4;
+    // Приоритет для execute()
+    static const int DEFAULT_PRIORITY = 2;
+
     ThreadPool(size_t minThreads, size_t maxThreads, bool verbose = false);
     ~ThreadPool();
 
     // Запускает задачу с указанным приоритетом и возвращает future для получения результата
     template<class F, class... Args>
-    auto enqueue(int priority, F&& f, Args&&... args) 
+    auto enqueue(int priority, F&& f, Args&&... args)
         -> std::future<typename std::invoke_result<F, Args...>::type>
     {
         using return_type = typename std::invoke_result<F, Args...>::type;
@@ -38,18 +138,24 @@ public:
         auto task = std::make_shared< std::packaged_task<return_type()> >(
                 std::bind(std::forward<F>(f), std::forward<Args>(args)...)
             );
-                
+
         std::future<return_type> res = task->get_future();
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
+        submit(priority, InlineTask([task](){ (*task)(); }));
+        return res;
+    }
 
-            if(stop.load())
-                throw std::runtime_error("enqueue on stopped ThreadPool");
+    // Запускает задачу без future (fire-and-forget). Небольшие лямбды хранятся
+    // в очереди по значению, поэтому из внешних потоков задача ставится без выделения памяти.
+    template<class F>
+    void post(int priority, F&& f)
+    {
+        submit(priority, InlineTask(std::forward<F>(f)));
+    }
 
-            tasks.emplace(PrioritizedTask{priority, [task](){ (*task)(); }});
-        }
-        condition.notify_one();
-        return res;
+    template<class F>
+    void execute(F&& f)
+    {
+        post(DEFAULT_PRIORITY, std::forward<F>(f));
     }
 
     // Останавливает пул потоков
@@ -60,18 +166,45 @@ public:
 
     size_t getMaxThreads();
 
-private:
-    // Рабочие потоки
-    std::vector<std::thread> workers;
-
-    // Приоритетная очередь задач
-    std::priority_queue<PrioritizedTask> tasks;
-
-    // Мьютекс для защиты очереди задач
-    std::mutex queueMutex;
+    // Текущее количество рабочих потоков
+    size_t getThreadCount();
 
-    // Условная переменная для уведомления потоков
-    std::condition_variable condition;
+private:
+    // Задача в очереди с временем постановки (для измерения задержки очереди)
+    struct Task {
+        InlineTask fn;
+        int64_t enqueuedNs = 0;
+    };
+
+    // Рабочий поток: по одному деку на полосу и статистика для автомасштабирования.
+    // Статистику пишет только сам поток, читает поток мониторинга.
+    struct Worker {
+        WorkStealingDeque<Task> deques[NUM_LANES];
+        std::atomic<bool> used{false};      // слот занят (поток запущен и ещё не присоединён)
+        std::atomic<bool> finished{false};  // поток завершился, его нужно присоединить
+        std::atomic<bool> busy{false};      // выполняет задачу
+        std::atomic<uint64_t> busyNs{0};    // суммарное время выполнения задач
+        std::atomic<uint64_t> maxWaitNs{0}; // максимальная задержка очереди с прошлого замера
+        std::thread thread;
+    };
+
+    // Слоты рабочих потоков (maxThreads штук), чужие деки просматриваются при перехвате
+    std::unique_ptr<Worker[]> slots;
+    std::atomic<size_t> slotCount{0};
+
+    // Глобальная очередь для задач из внешних потоков; при переполнении — overflow под мьютексом
+    std::unique_ptr<MpmcQueue<Task>> injection[NUM_LANES];
+    std::deque<Task> overflow[NUM_LANES];
+    std::mutex overflowMutex;
+    std::atomic<size_t> overflowCount{0};
+
+    // Количество задач, ещё не взятых на выполнение
+    std::atomic<size_t> pendingTasks{0};
+
+    // Засыпание простаивающих потоков
+    std::mutex parkMutex;
+    std::condition_variable parkCondition;
+    std::atomic<size_t> sleepers{0};
 
     // Флаги остановки пула
     std::atomic<bool> stop;
@@ -86,13 +219,22 @@ private:
 
     // Мониторинг нагрузки для динамического изменения размера пула
     std::thread monitorThread;
+    std::mutex monitorMutex;
+    std::condition_variable monitorCondition;
     void monitorLoad();
+    void reapFinished();
 
     // Добавление нового потока
     void addThread();
 
     // Логика уменьшения пула потоков
     std::atomic<int> threadsToTerminate; // Количество потоков, которые должны завершиться
+
+    void submit(int priority, InlineTask task);
+    void workerLoop(Worker* self, size_t index);
+    bool findTask(Worker* self, size_t index, Task& task);
+    void park();
+    static int laneOf(int priority);
 };
 
 #endif // THREADPOOL_H
@@ -0,0 +1,77 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <utility>
+
+// 哈希时间轮（Varghese & Lauck），添加和到期都是O(1)，适合大量精度要求不高的定时器。
+// 每个槽对应一个tick，超过一圈的定时器记录剩余圈数。只在一个线程（事件循环）中使用。
+template <typename T>
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimerWheel(size_t slots = 64, size_t tickMs = 250)
+        : slots_(slots ? slots : 1), tick_(tickMs ? tickMs : 1), last_(Clock::now())
+    {}
+
+    // delayMs 之后到期，向上取整到tick
+    void schedule(T item, size_t delayMs)
+    {
+        size_t ticks = (delayMs + tick_ - 1) / tick_;
+        if (ticks == 0) ticks = 1;
+        size_t slot = (cursor_ + ticks) % slots_.size();
+        slots_[slot].push_back({std::move(item), (ticks - 1) / slots_.size()});
+        ++size_;
+    }
+
+    // 推进到 now，对每个到期的定时器调用 expired(T&)；回调中可以再次 schedule
+    template <typename Callback>
+    void advance(Clock::time_point now, Callback&& expired)
+    {
+        auto tick = std::chrono::milliseconds(tick_);
+        while (now - last_ >= tick) {
+            last_ += tick;
+            cursor_ = (cursor_ + 1) % slots_.size();
+            if (slots_[cursor_].empty()) continue;
+
+            std::vector<Timer> due;
+            due.swap(slots_[cursor_]);
+            for (auto& timer: due) {
+                if (timer.rounds > 0) {
+                    --timer.rounds;
+                    slots_[cursor_].push_back(std::move(timer));
+                    continue;
+                }
+                --size_;
+                expired(timer.item);
+            }
+        }
+    }
+
+    // 距离下一个tick的毫秒数，用作 epoll_wait 的超时
+    int nextTimeout(Clock::time_point now) const
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_).count();
+        return elapsed >= (long long)tick_ ? 0 : (int)(tick_ - elapsed);
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    struct Timer {
+        T item;
+        size_t rounds;
+    };
+
+    std::vector<std::vector<Timer>> slots_;
+    size_t tick_;
+    size_t cursor_ = 0;
+    size_t size_ = 0;
+    Clock::time_point last_;
+};
+
+#endif // TIMERWHEEL_H
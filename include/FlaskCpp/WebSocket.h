@@ -0,0 +1,130 @@
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+struct Connection;
+class EventLoop;
+
+// 增量 WebSocket 帧解析器（RFC 6455）
+// 只接受客户端发送的带掩码的帧；分片的消息在解析器中拼接，控制帧可以插在分片之间。
+// 一帧完整到达后才解析，调用方负责从缓冲区中删除已经使用的字节。
+class WebSocketParser {
+public:
+    enum Opcode {
+        OP_CONTINUATION = 0x0,
+        OP_TEXT = 0x1,
+        OP_BINARY = 0x2,
+        OP_CLOSE = 0x8,
+        OP_PING = 0x9,
+        OP_PONG = 0xA
+    };
+
+    enum Result {
+        RESULT_NEED_MORE,       // 数据不足一帧
+        RESULT_MESSAGE,         // 完整的数据消息，见 message()
+        RESULT_CONTROL,         // 控制帧，见 controlOpcode()
+        RESULT_ERROR            // 协议错误，见 errorCode()
+    };
+
+    // 单个消息（所有分片合计）的最大字节数
+    static const size_t MAX_MESSAGE_SIZE = 16 * 1024 * 1024;
+
+    explicit WebSocketParser(size_t maxMessageSize = MAX_MESSAGE_SIZE) : maxMessageSize_(maxMessageSize) {}
+
+    // 从 data 开头解析到下一个完整的消息或控制帧为止，consumed 为已经使用的字节数；
+    // 中间的分片已经拼接到消息中，返回 RESULT_NEED_MORE 时 consumed 也可能不为0
+    Result parse(const char* data, size_t size, size_t& consumed);
+
+    // RESULT_MESSAGE 之后有效，直到下一个消息开始
+    const std::string& message() const { return message_; }
+    bool binary() const { return binary_; }
+
+    // RESULT_CONTROL 之后有效
+    Opcode controlOpcode() const { return controlOpcode_; }
+    const std::string& controlPayload() const { return control_; }
+
+    // RESULT_ERROR 之后有效：1002 协议错误、1007 文本不是UTF-8、1009 消息太大
+    uint16_t errorCode() const { return errorCode_; }
+
+    // 服务器发送的帧，不带掩码；编码一次后可以发送给多个连接
+    static std::string frame(Opcode opcode, std::string_view payload);
+    static std::string closeFrame(uint16_t code, std::string_view reason = "");
+
+    // Sec-WebSocket-Accept：base64(SHA-1(key + GUID))
+    static std::string acceptKey(std::string_view key);
+
+private:
+    size_t maxMessageSize_;
+    std::string message_;
+    bool binary_ = false;
+    bool inMessage_ = false;        // 已收到分片消息的第一帧，等待 FIN
+    bool complete_ = false;         // message_ 是已经返回的完整消息
+    Opcode controlOpcode_ = OP_CLOSE;
+    std::string control_;
+    uint16_t errorCode_ = 0;
+
+    Result fail(uint16_t code);
+};
+
+class WebSocket;
+using WebSocketPtr = std::shared_ptr<WebSocket>;
+
+// 一个 WebSocket 连接，握手之后由连接所属的事件循环负责读写，不占用工作线程。
+// 回调都在事件循环线程中执行，不能阻塞；耗时的处理交给其他线程，之后再 send()。
+// send() 和 close() 可以在任意线程调用。
+class WebSocket : public std::enable_shared_from_this<WebSocket> {
+public:
+    using OpenHandler = std::function<void(const WebSocketPtr&)>;
+    using MessageHandler = std::function<void(const WebSocketPtr&, const std::string& message, bool binary)>;
+    // code 为关闭帧中的状态码，没有状态码时为1005，连接异常断开时为1006
+    using CloseHandler = std::function<void(const WebSocketPtr&, uint16_t code)>;
+
+    WebSocket(const std::shared_ptr<Connection>& conn, OpenHandler onOpen,
+              MessageHandler onMessage, CloseHandler onClose);
+
+    // 连接已经关闭时返回false
+    bool send(std::string_view text);
+    bool sendBinary(std::string_view data);
+    // 预先用 WebSocketParser::frame() 编码的帧，广播时所有连接共享同一个缓冲区
+    bool sendFrame(std::shared_ptr<const std::string> frame);
+
+    // 发送关闭帧，等待客户端回复关闭帧后断开连接
+    void close(uint16_t code = 1000, std::string_view reason = "");
+
+    bool isOpen() const { return open_.load(); }
+    const std::string& ip() const { return ip_; }
+
+private:
+    friend class EventLoop;
+
+    std::weak_ptr<Connection> conn_;
+    EventLoop* loop_;
+    std::string ip_;
+    OpenHandler onOpen_;
+    MessageHandler onMessage_;
+    CloseHandler onClose_;
+    std::atomic<bool> open_{true};
+
+    // 以下只在事件循环线程中访问
+    WebSocketParser parser_;
+    bool closeSent_ = false;
+    uint16_t closeCode_ = 1006;
+
+    // 握手完成，连接已经交给事件循环
+    void opened();
+    // 处理 buffer 中的帧并删除已经使用的数据；需要立即断开连接时返回false
+    bool onData(Connection* conn, std::string& buffer);
+    // 连接已经断开，调用 onClose
+    void closed();
+    // 在事件循环线程中发送关闭帧（code 为0时不带状态码），disconnect 为true时发送完成后断开；
+    // 需要立即断开连接时返回false
+    bool sendClose(Connection* conn, uint16_t code, std::string_view reason, bool disconnect);
+};
+
+#endif // WEBSOCKET_H
@@ -0,0 +1,38 @@
+#ifndef FLASKCPP_UTILS_COMPRESS_H
+#define FLASKCPP_UTILS_COMPRESS_H
+
+#include <string>
+#include <string_view>
+
+namespace flaskcpp
+{
+
+enum ContentEncoding
+{
+    ENCODING_IDENTITY,
+    ENCODING_GZIP,
+    ENCODING_DEFLATE
+};
+
+// 响应压缩设置：level 为zlib压缩级别（1-9），0表示不压缩；主体小于 minSize 字节时不压缩
+struct CompressionOptions
+{
+    int level = 6;
+    size_t minSize = 1024;
+};
+
+// 按 Accept-Encoding 选择编码，优先 gzip；q=0 的编码不使用
+ContentEncoding negotiateEncoding(std::string_view acceptEncoding);
+
+// "gzip"、"deflate"，identity 返回空字符串
+const char* encodingName(ContentEncoding encoding);
+
+// text/*、JSON、JavaScript、XML、SVG 等适合压缩，图片和压缩包不压缩
+bool isCompressibleType(std::string_view contentType);
+
+// 压缩 data 写入 out（gzip 或 zlib 格式），失败返回false
+bool compress(std::string_view data, std::string& out, ContentEncoding encoding, int level);
+
+}
+
+#endif // FLASKCPP_UTILS_COMPRESS_H
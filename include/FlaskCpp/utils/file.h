@@ -5,6 +5,7 @@
 #include <fstream>
 #include <vector>
 #include <FlaskCpp/FlaskTypes.h>
+#include <FlaskCpp/utils/responseWriter.h>
 
 namespace flaskcpp
 {
@@ -34,24 +35,43 @@ public:
 
     size_t read(std::vector<char>& data);
 
+    // generateHeader() 之后有效：磁盘文件的 ETag 和修改时间，内存数据的 ETag 为内容哈希、修改时间为0
+    const std::string& etag() const { return etag_; }
+    std::time_t lastModified() const { return last_modified_; }
+
+    // 把文件内容（已处理Range）加入 chain：磁盘文件发送时使用sendfile，内存中的数据直接引用，
+    // 发送完成前 FileHandler 必须保持有效
+    bool appendTo(ResponseChain& chain);
+
     void setFileData(std::vector<char> data);
+
+    // 发送预先压缩的文件（例如同目录下的 .gz），Content-Type 和文件名保持不变
+    void setEncoded(const std::string& encoded_path, const std::string& encoding);
     
 private:
     std::string path, file_name;
     bool as_attachment=false;
     std::string content_type;
+    std::string content_encoding;
     std::ifstream file;
     bool end_read=false;
     int64_t start_=-1, end_=-1;
     bool init_=false;
 
+    std::string etag_;
+    std::time_t last_modified_=0;
+
     std::vector<char> file_data={};
 
     size_t current_pos = 0;
 };
 
+// 把上传的临时文件移动到 path（rename，跨文件系统时复制），成功返回空字符串，否则返回原因
 std::string save_file(const RequestData::File& file, const std::string& path, bool path_is_file=false);
 
+// 通过sendfile将文件的 [offset, offset+count) 发送到socket，支持非阻塞socket
+bool sendFileRange(int socket, const std::string& path, size_t offset, size_t count);
+
 }
 
 
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <vector>
 #include <unordered_map>
+#include <functional>
 
 #include "FlaskCpp/utils/json.h"
 
@@ -14,6 +15,7 @@ enum ResponseType
     RESP_TYPE_UNDEFINED,
     RESP_TYPE_TEXT,
     RESP_TYPE_JSON,
+    RESP_TYPE_STREAM,   // 主体由 Response::stream 分块生成
 
     RESP_TYPE_CONTINUE = 100,
     RESP_TYPE_SWITCHING_PROTOCOLS = 101,
@@ -112,10 +114,27 @@ static const std::map<int, std::string> HttpStatusMap = {
     {505, "HTTP Version Not Supported"}
 };
 
+// 流式响应：producer 通过 write 分块写出主体，write 返回false表示客户端已断开。
+// 小块数据先合并（最多 STREAM_BUFFER_SIZE 字节）再作为一个 chunk 发送，write(nullptr, 0) 立即发送已合并的数据。
+// socket 缓冲区满时 write 会等待，producer 的速度受客户端接收速度限制。
+using StreamWriter = std::function<bool(const char* data, size_t size)>;
+using StreamProducer = std::function<void(const StreamWriter& write)>;
+// 拉取方式：每次调用写入下一块数据到 chunk，返回false表示结束（此时 chunk 不发送）
+using StreamGenerator = std::function<bool(std::string& chunk)>;
+
+static const size_t STREAM_BUFFER_SIZE = 16 * 1024;
+
 struct Response
 {   
     int type = RESP_TYPE_UNDEFINED;
+    // 响应头；主体单独放在 body 中，发送时与响应头一起交给 sendmsg，不再拼接
     std::string text;
+    std::string body;
+    // send_text 生成的 ETag，用于返回304
+    std::string etag;
+
+    // RESP_TYPE_STREAM: text 只包含响应头，主体使用 chunked 编码发送
+    StreamProducer stream;
 
     std::string file_path, file_name;
     std::vector<char> file_data;
@@ -138,6 +157,14 @@ Response send_text(std::string text,
 Response send_text(JsonGenerator& json, 
                    std::vector<std::pair<std::string, std::string>> extra_headers={});
 
+// 主体长度未知的响应，content_type 为空时使用 text/html
+Response send_stream(StreamProducer producer, std::string content_type="",
+                     std::vector<std::pair<std::string, std::string>> extra_headers={});
+
+// 主体由 generator 逐块生成，其他同 send_stream
+Response send_generator(StreamGenerator generator, std::string content_type="",
+                        std::vector<std::pair<std::string, std::string>> extra_headers={});
+
 Response send_file(std::string file_path, std::string file_name, bool as_attachment=false, 
                    std::vector<std::pair<std::string, std::string>> extra_headers={});
 
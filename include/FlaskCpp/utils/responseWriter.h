@@ -0,0 +1,104 @@
+#ifndef FLASKCPP_UTILS_RESPONSE_WRITER_H
+#define FLASKCPP_UTILS_RESPONSE_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <ctime>
+#include <sys/stat.h>
+
+namespace flaskcpp
+{
+
+// 预先生成的状态行 "HTTP/1.1 200 OK\r\n"，未知状态码返回空字符串
+const std::string& statusLine(int status);
+
+// "Date: ...\r\n" 头部，每个线程每秒最多格式化一次
+const std::string& dateHeader();
+
+// "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string httpDate(std::time_t t);
+// 解析 httpDate 格式的日期，失败返回-1
+std::time_t parseHttpDate(std::string_view value);
+
+// 文件的 ETag 由 inode、大小和修改时间生成，内存中的主体使用内容的哈希
+std::string fileETag(const struct stat& info);
+std::string contentETag(std::string_view body);
+
+// 按 RFC 7232 判断是否可以返回304：有 If-None-Match 时只比较 ETag（弱比较），
+// 否则比较 If-Modified-Since；lastModified 为0表示未知
+bool isNotModified(std::string_view ifNoneMatch, std::string_view ifModifiedSince,
+                   std::string_view etag, std::time_t lastModified);
+
+// 直接向一个字符串追加 HTTP 响应，不使用 ostringstream。
+// 字符串可以重复使用（clear() 保留容量）。
+class ResponseWriter
+{
+public:
+    explicit ResponseWriter(std::string& out) : out(out) {}
+
+    // 状态行和 Date 头部；未知状态码按500处理
+    ResponseWriter& status(int status);
+
+    ResponseWriter& header(std::string_view name, std::string_view value);
+    ResponseWriter& header(std::string_view name, uint64_t value);
+
+    // text/* 和 application/json 自动加上 charset=utf-8
+    ResponseWriter& contentType(std::string_view type);
+    ResponseWriter& contentLength(uint64_t length);
+    ResponseWriter& headers(const std::vector<std::pair<std::string, std::string>>& extra_headers);
+
+    // 结束响应头，并为主体预留空间
+    ResponseWriter& endHeaders(size_t bodySize = 0);
+    ResponseWriter& body(std::string_view data);
+
+    // 完整的响应：状态行、Content-Type、Content-Length、附加头部和主体
+    static std::string build(int status, std::string_view content_type, std::string_view body,
+                             const std::vector<std::pair<std::string, std::string>>& extra_headers = {});
+
+    // 没有主体的304响应，带上 ETag 和 Last-Modified
+    static std::string buildNotModified(std::string_view etag, std::time_t lastModified);
+
+    // 只生成响应头，主体单独发送（见 ResponseChain）
+    static std::string buildHeader(int status, std::string_view content_type, size_t body_size,
+                                   const std::vector<std::pair<std::string, std::string>>& extra_headers = {});
+
+private:
+    std::string& out;
+    void appendNumber(uint64_t value);
+};
+
+// 由内存块和文件区间组成的响应，按顺序发送：
+// 相邻的内存块合并为一次 sendmsg（writev），文件区间使用 sendfile，部分写入时从断点继续。
+class ResponseChain
+{
+public:
+    // 引用外部数据，发送完成前必须保持有效
+    void add(std::string_view data);
+    // 数据由 ResponseChain 持有
+    void add(std::string&& data);
+    // 文件区间 [offset, offset+count)，发送时打开文件
+    void addFile(std::string path, uint64_t offset, uint64_t count);
+
+    bool empty() const { return segments.empty(); }
+    uint64_t size() const;
+
+    // 发送全部内容；非阻塞socket缓冲区满时等待可写，出错或超时返回false
+    bool sendTo(int socket, int timeout_ms = 30000);
+
+private:
+    struct Segment {
+        const char* data = nullptr;
+        uint64_t size = 0;
+        std::string path;   // 非空表示文件区间
+        uint64_t offset = 0;
+    };
+    std::vector<Segment> segments;
+    std::deque<std::string> owned;
+};
+
+}
+
+#endif // FLASKCPP_UTILS_RESPONSE_WRITER_H
@@ -0,0 +1,110 @@
+#ifndef FLASKCPP_UTILS_STATIC_CACHE_H
+#define FLASKCPP_UTILS_STATIC_CACHE_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "FlaskCpp/utils/compress.h"
+
+namespace flaskcpp
+{
+
+// 静态文件缓存：小文件内容保存在内存中，大文件使用mmap，超过内存预算的文件不缓存（sendfile发送）。
+// 每个条目最多每 checkInterval 毫秒 stat 一次，文件被修改、替换或删除后重新加载。
+// 按LRU淘汰，缓存的总字节数不超过 maxBytes。
+class StaticCache
+{
+public:
+    struct Entry
+    {
+        std::string path;
+        // Content-Type、Content-Length、ETag 和 Last-Modified（压缩版本还有 Content-Encoding 和 Vary），
+        // 不包含状态行、Date 和结束的空行
+        std::string headers;
+        std::string etag;
+        uint64_t size = 0;
+        timespec mtime = {};
+
+        // 文件内容；not cached 时为空，应通过 path 用sendfile发送
+        std::string_view body() const { return {data, cached ? (size_t)size : 0}; }
+        bool isCached() const { return cached || size == 0; }
+
+        Entry() = default;
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+        ~Entry();
+
+    private:
+        friend class StaticCache;
+        std::string key;             // 文件路径，压缩版本加上编码
+        uint64_t fileSize = 0;       // 用于检查文件是否修改，压缩后 size 为压缩后的大小
+        std::string buffer;          // 小文件或压缩后的内容
+        void* mapped = nullptr;      // 大文件
+        const char* data = nullptr;
+        bool cached = false;
+        dev_t dev = 0;
+        ino_t ino = 0;
+        mutable std::atomic<int64_t> checkedMs{0};
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    explicit StaticCache(size_t maxBytes = 64 << 20, size_t smallFileLimit = 64 << 10, int checkIntervalMs = 1000);
+
+    // 文件不存在或不是普通文件时返回nullptr
+    EntryPtr get(const std::string& path);
+
+    // 压缩版本：gzip 优先使用同目录下预先压缩的 path.gz，否则压缩一次后缓存。
+    // 文件类型不适合压缩、小于 options.minSize 或超过内存预算时返回nullptr
+    EntryPtr getEncoded(const std::string& path, ContentEncoding encoding, const CompressionOptions& options);
+
+    // maxBytes: 内存预算；smallFileLimit: 不超过该大小的文件读入内存，更大的文件使用mmap
+    void setLimits(size_t maxBytes, size_t smallFileLimit);
+    // 0表示每次请求都检查文件是否修改
+    void setCheckInterval(int ms);
+    void clear();
+
+    Stats stats() const;
+
+private:
+    using LruList = std::list<EntryPtr>;
+
+    mutable std::mutex mutex;
+    LruList lru;    // 最近使用的在前
+    std::unordered_map<std::string, LruList::iterator> entries;
+    size_t bytes = 0;
+    size_t maxBytes, smallFileLimit;
+    std::atomic<int> checkInterval;
+
+    std::atomic<uint64_t> hits{0}, misses{0}, evictions{0};
+
+    EntryPtr lookup(const std::string& key);
+    // 最多每 checkInterval 毫秒 stat 一次；文件已修改或删除时移除条目并返回false
+    bool validate(const EntryPtr& entry);
+    EntryPtr load(const std::string& key, const std::string& path, const struct stat& info,
+                  const char* contentType, const char* encoding);
+    EntryPtr compressFile(const std::string& key, const std::string& path, const struct stat& info,
+                          ContentEncoding encoding, int level);
+    void insert(const EntryPtr& entry);
+    void erase(const EntryPtr& entry);
+    void evict();
+};
+
+}
+
+#endif // FLASKCPP_UTILS_STATIC_CACHE_H
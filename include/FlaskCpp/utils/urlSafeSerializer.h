@@ -1,4 +1,8 @@
+#ifndef FLASKCPP_UTILS_URL_SAFE_SERIALIZER_H
+#define FLASKCPP_UTILS_URL_SAFE_SERIALIZER_H
+
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstdint>
 #include <algorithm>
@@ -59,109 +63,84 @@ private:
         return outer_hash;
     }
     
-    // SHA1哈希函数简化实现
-    std::string sha1_hash(const std::string& data) const {
-        // 初始化哈希值
-        uint32_t h0 = 0x67452301;
-        uint32_t h1 = 0xEFCDAB89;
-        uint32_t h2 = 0x98BADCFE;
-        uint32_t h3 = 0x10325476;
-        uint32_t h4 = 0xC3D2E1F0;
-
-        
-        
-        // 预处理：填充数据
-        std::string padded_data = data;
-        padded_data.push_back(static_cast<char>(0x80));
-
-        
-        
-        // 填充0直到长度 ≡ 448 (mod 512)
-        while ((padded_data.size() * 8) % 512 != 448) {
-            padded_data.push_back('\0');
+public:
+    // SHA-1 摘要，返回20字节的原始数据。
+    // 输入按64字节块直接处理，不复制；只有最后不完整的块和填充放在栈上的缓冲区中
+    static std::string sha1_hash(std::string_view data) {
+        uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+        size_t full = data.size() & ~(size_t)63;
+        for (size_t i = 0; i < full; i += 64) {
+            sha1_block(h, p + i);
         }
 
-        
-        
-        // 附加原始数据长度（64位）
-        uint64_t original_bit_length = data.size() * 8;
-        for (int i = 7; i >= 0; --i) {
-            padded_data.push_back(static_cast<char>((original_bit_length >> (8 * i)) & 0xFF));
+        // 剩余数据 + 0x80 + 填充0 + 64位长度（大端），共一个或两个块
+        unsigned char tail[128] = {0};
+        size_t rest = data.size() - full;
+        if (rest) memcpy(tail, p + full, rest);
+        tail[rest] = 0x80;
+        size_t tail_size = rest < 56 ? 64 : 128;
+        uint64_t bit_length = static_cast<uint64_t>(data.size()) * 8;
+        for (int i = 0; i < 8; ++i) {
+            tail[tail_size - 1 - i] = static_cast<unsigned char>(bit_length >> (8 * i));
         }
+        sha1_block(h, tail);
+        if (tail_size == 128) sha1_block(h, tail + 64);
+
+        std::string result(20, '\0');
+        for (int i = 0; i < 5; ++i) {
+            result[i * 4] = static_cast<char>(h[i] >> 24);
+            result[i * 4 + 1] = static_cast<char>(h[i] >> 16);
+            result[i * 4 + 2] = static_cast<char>(h[i] >> 8);
+            result[i * 4 + 3] = static_cast<char>(h[i]);
+        }
+        return result;
+    }
 
-        
-        
-        // 处理512位块
-        for (size_t i = 0; i < padded_data.size(); i += 64) {
-            std::vector<uint32_t> w(80, 0);
-            
-            // 将块分解为16个32位字
-            for (size_t j = 0; j < 16; ++j) {
-                w[j] = (static_cast<uint32_t>(padded_data[i + j * 4]) << 24) |
-                         (static_cast<uint32_t>(padded_data[i + j * 4 + 1]) << 16) |
-                         (static_cast<uint32_t>(padded_data[i + j * 4 + 2]) << 8) |
-                         (static_cast<uint32_t>(padded_data[i + j * 4 + 3]));
-            }
-            
-            // 扩展16个字为80个字
-            for (size_t j = 16; j < 80; ++j) {
-                w[j] = left_rotate(w[j-3] ^ w[j-8] ^ w[j-14] ^ w[j-16], 1);
-            }
-            
-            // 初始化工作变量
-            uint32_t a = h0, b = h1, c = h2, d = h3, e = h4;
-            
-            // 主循环
-            for (size_t j = 0; j < 80; ++j) {
-                uint32_t f, k;
-                
-                if (j < 20) {
-                    f = (b & c) | ((~b) & d);
-                    k = 0x5A827999;
-                } else if (j < 40) {
-                    f = b ^ c ^ d;
-                    k = 0x6ED9EBA1;
-                } else if (j < 60) {
-                    f = (b & c) | (b & d) | (c & d);
-                    k = 0x8F1BBCDC;
-                } else {
-                    f = b ^ c ^ d;
-                    k = 0xCA62C1D6;
-                }
-                
-                uint32_t temp = left_rotate(a, 5) + f + e + k + w[j];
-                e = d;
-                d = c;
-                c = left_rotate(b, 30);
-                b = a;
-                a = temp;
-            }
-            
-            // 添加到当前哈希值
-            h0 += a;
-            h1 += b;
-            h2 += c;
-            h3 += d;
-            h4 += e;
+private:
+    // 处理一个512位块
+    static void sha1_block(uint32_t h[5], const unsigned char* block) {
+        uint32_t w[80];
+        // 按无符号字节组合，避免 char 的符号扩展
+        for (int j = 0; j < 16; ++j) {
+            w[j] = (static_cast<uint32_t>(block[j * 4]) << 24) |
+                   (static_cast<uint32_t>(block[j * 4 + 1]) << 16) |
+                   (static_cast<uint32_t>(block[j * 4 + 2]) << 8) |
+                   (static_cast<uint32_t>(block[j * 4 + 3]));
+        }
+        for (int j = 16; j < 80; ++j) {
+            w[j] = left_rotate(w[j-3] ^ w[j-8] ^ w[j-14] ^ w[j-16], 1);
         }
-        
-        
 
-        // 转换为字节字符串
-        std::string result;
-        for (auto val : {h0, h1, h2, h3, h4}) {
-            for (int i = 3; i >= 0; --i) {
-                result.push_back(static_cast<char>((val >> (8 * i)) & 0xFF));
-            }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], temp;
+        // 四轮分开写，循环内没有分支
+        for (int j = 0; j < 20; ++j) {
+            temp = left_rotate(a, 5) + ((b & c) | (~b & d)) + e + 0x5A827999 + w[j];
+            e = d; d = c; c = left_rotate(b, 30); b = a; a = temp;
+        }
+        for (int j = 20; j < 40; ++j) {
+            temp = left_rotate(a, 5) + (b ^ c ^ d) + e + 0x6ED9EBA1 + w[j];
+            e = d; d = c; c = left_rotate(b, 30); b = a; a = temp;
+        }
+        for (int j = 40; j < 60; ++j) {
+            temp = left_rotate(a, 5) + ((b & c) | (b & d) | (c & d)) + e + 0x8F1BBCDC + w[j];
+            e = d; d = c; c = left_rotate(b, 30); b = a; a = temp;
+        }
+        for (int j = 60; j < 80; ++j) {
+            temp = left_rotate(a, 5) + (b ^ c ^ d) + e + 0xCA62C1D6 + w[j];
+            e = d; d = c; c = left_rotate(b, 30); b = a; a = temp;
         }
 
-        
-            
-        return result;
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
     }
     
     // 左旋转函数
-    uint32_t left_rotate(uint32_t value, size_t count) const {
+    static uint32_t left_rotate(uint32_t value, size_t count) {
         return (value << count) | (value >> (32 - count));
     }
 
@@ -401,3 +380,5 @@ public:
     
 //     return result;
 // }
+
+#endif // FLASKCPP_UTILS_URL_SAFE_SERIALIZER_H
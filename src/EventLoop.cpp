@@ -0,0 +1,654 @@
+#include "FlaskCpp/EventLoop.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+static const size_t READ_CHUNK_SIZE = 16 * 1024;
+static const size_t STREAM_FLUSH_SIZE = 64 * 1024;
+static const int MAX_OUTPUT_IOV = 64;
+
+static const char CONTINUE_RESPONSE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+static const char BAD_REQUEST_RESPONSE[] =
+    "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+static const char TOO_LARGE_RESPONSE[] =
+    "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+// 短的状态响应直接发送，不等待socket可写
+static void sendStatus(int fd, const char* data, size_t size)
+{
+    ssize_t r = send(fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+    (void)r;
+}
+
+EventLoop::EventLoop(int listenFd, RequestCallback onRequest)
+:listenFd(listenFd), onRequest(onRequest)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &this->listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+    lastSweep = std::chrono::steady_clock::now();
+}
+
+EventLoop::~EventLoop()
+{
+    {
+        std::lock_guard<std::mutex> lock(connMutex);
+        for (auto& it: connections) {
+            close(it.first);
+        }
+        connections.clear();
+    }
+    if (listenFd >= 0) close(listenFd);
+    if (wakeFd >= 0) close(wakeFd);
+    if (epollFd >= 0) close(epollFd);
+}
+
+void EventLoop::setRequestTimeout(size_t ms)
+{
+    requestTimeout = ms;
+}
+
+void EventLoop::setIdleTimeout(size_t ms)
+{
+    idleTimeout = ms;
+}
+
+int EventLoop::sweepInterval()
+{
+    // 检查间隔取超时时间的一半，范围 [10ms, 1s]
+    size_t interval = std::min(requestTimeout, idleTimeout ? idleTimeout : requestTimeout) / 2;
+    return (int)std::max<size_t>(10, std::min<size_t>(1000, interval));
+}
+
+void EventLoop::setMultipartFactory(MultipartFactory factory)
+{
+    multipartFactory = factory;
+}
+
+void EventLoop::setBodyLimit(BodyLimit limit)
+{
+    bodyLimit = limit;
+}
+
+bool EventLoop::onHeaders(Connection& conn, HttpParser::State state)
+{
+    HttpParser& parser = conn.parser;
+    conn.bodyLimit = 0;
+    if (!parser.hasBody()) return true;
+
+    if (bodyLimit) conn.bodyLimit = bodyLimit(parser);
+    // chunked 主体的长度在接收过程中检查
+    if (conn.bodyLimit && parser.contentLength() > conn.bodyLimit) {
+        sendStatus(conn.fd, TOO_LARGE_RESPONSE, sizeof(TOO_LARGE_RESPONSE) - 1);
+        return false;
+    }
+
+    // 客户端在收到 100 Continue 之后才发送主体
+    if (state == HttpParser::STATE_BODY && parser.version() == "HTTP/1.1" &&
+        strEqualsIgnoreCase(parser.header("Expect"), "100-continue"))
+    {
+        sendStatus(conn.fd, CONTINUE_RESPONSE, sizeof(CONTINUE_RESPONSE) - 1);
+    }
+
+    if (multipartFactory) conn.multipart = multipartFactory(parser);
+    return true;
+}
+
+HttpParser::State EventLoop::parseRequest(Connection& conn)
+{
+    HttpParser& parser = conn.parser;
+    bool headersDone = parser.state() == HttpParser::STATE_BODY || parser.state() == HttpParser::STATE_COMPLETE;
+    HttpParser::State state = parser.parse(conn.buffer);
+    if (state == HttpParser::STATE_ERROR) {
+        // 格式错误的请求（例如无效的 Content-Length）回复400后关闭连接
+        sendStatus(conn.fd, BAD_REQUEST_RESPONSE, sizeof(BAD_REQUEST_RESPONSE) - 1);
+        return state;
+    }
+    if (state != HttpParser::STATE_BODY && state != HttpParser::STATE_COMPLETE) return state;
+
+    if (!headersDone && !onHeaders(conn, state)) return HttpParser::STATE_ERROR;
+
+    if (conn.multipart) {
+        // 把已经到达的主体交给multipart解析器，buffer中只保留请求头
+        size_t start = parser.bodyStart();
+        size_t size = std::min(conn.buffer.size() - start, parser.bodyRemaining());
+        if (size > 0) {
+            if (!conn.multipart->write(conn.buffer.data() + start, size)) return HttpParser::STATE_ERROR;
+            conn.buffer.erase(start, size);
+            parser.consumeBody(size);
+            state = parser.parse(conn.buffer);
+            if (state == HttpParser::STATE_ERROR) {
+                sendStatus(conn.fd, BAD_REQUEST_RESPONSE, sizeof(BAD_REQUEST_RESPONSE) - 1);
+                return state;
+            }
+        }
+    }
+
+    if (conn.bodyLimit && parser.contentLength() > conn.bodyLimit) {
+        sendStatus(conn.fd, TOO_LARGE_RESPONSE, sizeof(TOO_LARGE_RESPONSE) - 1);
+        return HttpParser::STATE_ERROR;
+    }
+    // 主体结束时没有读到结束分隔符，最后一个部分不完整
+    if (state == HttpParser::STATE_COMPLETE && conn.multipart && !conn.multipart->finished()) {
+        sendStatus(conn.fd, BAD_REQUEST_RESPONSE, sizeof(BAD_REQUEST_RESPONSE) - 1);
+        return HttpParser::STATE_ERROR;
+    }
+    return state;
+}
+
+size_t EventLoop::getConnectionCount()
+{
+    std::lock_guard<std::mutex> lock(connMutex);
+    return connections.size();
+}
+
+void EventLoop::stop()
+{
+    stopped.store(true);
+    uint64_t one = 1;
+    ssize_t r = write(wakeFd, &one, sizeof(one));
+    (void)r;
+}
+
+void EventLoop::loop()
+{
+    std::vector<epoll_event> events(256);
+    while (!stopped.load()) {
+        int timeout = sweepInterval();
+        if (!heartbeats.empty()) {
+            timeout = std::min(timeout, heartbeats.nextTimeout(std::chrono::steady_clock::now()));
+        }
+        int n = epoll_wait(epollFd, events.data(), events.size(), timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            void* ptr = events[i].data.ptr;
+            if (ptr == &listenFd) {
+                acceptAll();
+            }
+            else if (ptr == &wakeFd) {
+                uint64_t v;
+                ssize_t r = read(wakeFd, &v, sizeof(v));
+                (void)r;
+            }
+            else {
+                Connection* conn = static_cast<Connection*>(ptr);
+                if (conn->websocket) handleWebSocket(conn, events[i].events);
+                else if (conn->sse) handleSSE(conn, events[i].events);
+                else readAll(conn);
+            }
+        }
+        // 任务和心跳可能关闭连接，放在处理完本批事件之后
+        runTasks();
+        sendHeartbeats();
+        sweepExpired();
+    }
+
+    // 关闭监听socket、SSE/WebSocket 连接和所有空闲连接，正在处理的连接由工作线程关闭
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, listenFd, nullptr);
+    close(listenFd);
+    listenFd = -1;
+    std::vector<Connection*> detached(websockets.begin(), websockets.end());
+    for (auto& it: channels) {
+        detached.insert(detached.end(), it.second.begin(), it.second.end());
+    }
+    static const auto goingAway = std::make_shared<const std::string>(WebSocketParser::closeFrame(1001));
+    for (Connection* conn: detached) {
+        if (conn->websocket) sendBuffer(conn, goingAway);
+        removeDetached(conn);
+    }
+    std::lock_guard<std::mutex> lock(connMutex);
+    for (auto it = connections.begin(); it != connections.end();) {
+        if (!it->second->busy.load()) {
+            close(it->first);
+            it = connections.erase(it);
+        }
+        else ++it;
+    }
+}
+
+void EventLoop::acceptAll()
+{
+    while (true) {
+        sockaddr_in6 clientAddr;
+        socklen_t clientLen = sizeof(clientAddr);
+        int fd = accept4(listenFd, (sockaddr*)&clientAddr, &clientLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            // EAGAIN: 已经全部accept；其他错误（如EMFILE）等待下一次事件
+            return;
+        }
+
+        char clientIP[INET6_ADDRSTRLEN];
+        inet_ntop(AF_INET6, &clientAddr.sin6_addr, clientIP, INET6_ADDRSTRLEN);
+        bool fromIPV4 = strncmp(clientIP, "::ffff:", 7) == 0;
+
+        auto conn = std::make_shared<Connection>();
+        conn->fd = fd;
+        conn->ip = fromIPV4 ? clientIP + 7 : clientIP;
+        conn->loop = this;
+        conn->lastActive = std::chrono::steady_clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(connMutex);
+            connections[fd] = conn;
+        }
+
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLET | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.ptr = conn.get();
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            removeConnection(fd);
+        }
+    }
+}
+
+void EventLoop::readAll(Connection* conn)
+{
+    int fd = conn->fd;
+    bool peerClosed = false;
+    while (true) {
+        size_t old = conn->buffer.size();
+        conn->buffer.resize(old + READ_CHUNK_SIZE);
+        ssize_t r = recv(fd, &conn->buffer[old], READ_CHUNK_SIZE, 0);
+        if (r > 0) {
+            conn->buffer.resize(old + r);
+            // 流式接收的主体边读边交给解析器，不在buffer中堆积
+            if (conn->buffer.size() >= STREAM_FLUSH_SIZE && 
+                parseRequest(*conn) == HttpParser::STATE_ERROR)
+            {
+                removeConnection(fd);
+                return;
+            }
+            continue;
+        }
+        conn->buffer.resize(old);
+        if (r == 0) {
+            peerClosed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        removeConnection(fd);
+        return;
+    }
+    conn->lastActive = std::chrono::steady_clock::now();
+
+    // 解析器从上次停止的位置继续扫描
+    HttpParser::State state = parseRequest(*conn);
+    if (state == HttpParser::STATE_ERROR || (state != HttpParser::STATE_COMPLETE && peerClosed)) {
+        removeConnection(fd);
+        return;
+    }
+    if (state != HttpParser::STATE_COMPLETE) {
+        rearm(conn);
+        return;
+    }
+
+    // 请求已完整缓冲，交给工作线程
+    std::shared_ptr<Connection> shared;
+    {
+        std::lock_guard<std::mutex> lock(connMutex);
+        auto it = connections.find(fd);
+        if (it == connections.end()) return;
+        shared = it->second;
+    }
+    conn->busy.store(true);
+    onRequest(shared);
+}
+
+void EventLoop::rearm(Connection* conn)
+{
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLET | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+        removeConnection(conn->fd);
+    }
+}
+
+void EventLoop::sweepExpired()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastSweep < std::chrono::milliseconds(sweepInterval())) return;
+    lastSweep = now;
+
+    auto timeout = std::chrono::milliseconds(requestTimeout);
+    auto idle = std::chrono::milliseconds(idleTimeout);
+    std::lock_guard<std::mutex> lock(connMutex);
+    for (auto it = connections.begin(); it != connections.end();) {
+        auto& conn = it->second;
+        if (conn->busy.load()) {
+            ++it;
+            continue;
+        }
+        // 持久连接在两次请求之间使用空闲超时，正在接收的请求使用请求超时
+        bool waiting = conn->requestCount > 0 && conn->buffer.empty();
+        if (now - conn->lastActive > (waiting ? idle : timeout)) {
+            close(it->first);
+            it = connections.erase(it);
+        }
+        else ++it;
+    }
+}
+
+void EventLoop::removeConnection(int fd)
+{
+    std::lock_guard<std::mutex> lock(connMutex);
+    auto it = connections.find(fd);
+    if (it != connections.end()) {
+        connections.erase(it);
+        close(fd);
+    }
+}
+
+void EventLoop::resume(const std::shared_ptr<Connection>& conn)
+{
+    conn->lastActive = std::chrono::steady_clock::now();
+    conn->busy.store(false);
+    rearm(conn.get());
+}
+
+void EventLoop::closeConnection(const std::shared_ptr<Connection>& conn)
+{
+    std::lock_guard<std::mutex> lock(connMutex);
+    auto it = connections.find(conn->fd);
+    if (it != connections.end() && it->second == conn) {
+        connections.erase(it);
+        close(conn->fd);
+    }
+    conn->fd = -1;
+}
+
+void EventLoop::setHeartbeatInterval(size_t ms)
+{
+    heartbeatInterval = ms;
+}
+
+void EventLoop::setMaxPendingBytes(size_t bytes)
+{
+    maxPendingBytes = bytes;
+}
+
+void EventLoop::post(std::function<void()> task)
+{
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        wake = tasks.empty();
+        tasks.push_back(std::move(task));
+    }
+    // 队列中已有任务时事件循环已经被唤醒
+    if (wake) {
+        uint64_t one = 1;
+        ssize_t r = write(wakeFd, &one, sizeof(one));
+        (void)r;
+    }
+}
+
+void EventLoop::runTasks()
+{
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        ready.swap(tasks);
+    }
+    for (auto& task: ready) {
+        task();
+    }
+}
+
+void EventLoop::subscribe(const std::shared_ptr<Connection>& conn, const std::string& channel)
+{
+    conn->sse = true;
+    conn->channel = channel;
+    post([this, conn]() {
+        // 客户端在 SSE 连接上发送的数据没有意义
+        conn->buffer.clear();
+        conn->multipart.reset();
+        conn->lastWrite = std::chrono::steady_clock::now();
+        channels[conn->channel].insert(conn.get());
+        if (heartbeatInterval) heartbeats.schedule(conn, heartbeatInterval);
+        if (!watchOutput(conn.get(), false)) removeDetached(conn.get());
+    });
+}
+
+void EventLoop::publish(const std::string& channel, std::shared_ptr<const std::string> event)
+{
+    post([this, channel, event]() {
+        auto it = channels.find(channel);
+        if (it == channels.end()) return;
+        std::vector<Connection*> failed;
+        for (Connection* conn: it->second) {
+            if (!sendBuffer(conn, event)) failed.push_back(conn);
+        }
+        for (Connection* conn: failed) {
+            removeDetached(conn);
+        }
+    });
+}
+
+void EventLoop::upgrade(const std::shared_ptr<Connection>& conn, std::shared_ptr<WebSocket> websocket)
+{
+    // 握手请求之后的数据已经是 WebSocket 帧
+    size_t size = std::min(conn->parser.messageSize(), conn->buffer.size());
+    conn->buffer.erase(0, size);
+    conn->parser.reset();
+    conn->multipart.reset();
+    conn->websocket = std::move(websocket);
+    post([this, conn]() {
+        conn->lastActive = conn->lastWrite = std::chrono::steady_clock::now();
+        websockets.insert(conn.get());
+        if (heartbeatInterval) heartbeats.schedule(conn, heartbeatInterval);
+        conn->websocket->opened();
+        if (!watchOutput(conn.get(), false) ||
+            (!conn->buffer.empty() && !conn->websocket->onData(conn.get(), conn->buffer)))
+        {
+            removeDetached(conn.get());
+        }
+    });
+}
+
+bool EventLoop::watchOutput(Connection* conn, bool writable)
+{
+    // SSE/WebSocket 连接不再使用 EPOLLONESHOT，只有输出排队时才关注可写
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLET | EPOLLRDHUP | (writable ? (uint32_t)EPOLLOUT : 0u);
+    ev.data.ptr = conn;
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev) == 0;
+}
+
+void EventLoop::handleSSE(Connection* conn, uint32_t events)
+{
+    if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+        removeDetached(conn);
+        return;
+    }
+    if (events & EPOLLIN) {
+        char discard[1024];
+        while (true) {
+            ssize_t r = recv(conn->fd, discard, sizeof(discard), 0);
+            if (r > 0) continue;
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            removeDetached(conn);
+            return;
+        }
+    }
+    if ((events & EPOLLOUT) && !flushOutput(conn)) {
+        removeDetached(conn);
+    }
+}
+
+void EventLoop::handleWebSocket(Connection* conn, uint32_t events)
+{
+    if (events & EPOLLERR) {
+        removeDetached(conn);
+        return;
+    }
+    if ((events & EPOLLOUT) && !flushOutput(conn)) {
+        removeDetached(conn);
+        return;
+    }
+    if (!(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))) return;
+
+    // 对端关闭之前可能还发送了关闭帧，先读完再处理
+    bool peerClosed = false;
+    while (true) {
+        size_t old = conn->buffer.size();
+        conn->buffer.resize(old + READ_CHUNK_SIZE);
+        ssize_t r = recv(conn->fd, &conn->buffer[old], READ_CHUNK_SIZE, 0);
+        if (r > 0) {
+            conn->buffer.resize(old + r);
+            if (conn->buffer.size() >= STREAM_FLUSH_SIZE && !conn->websocket->onData(conn, conn->buffer)) {
+                removeDetached(conn);
+                return;
+            }
+            continue;
+        }
+        conn->buffer.resize(old);
+        if (r == 0) {
+            peerClosed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        removeDetached(conn);
+        return;
+    }
+    conn->lastActive = std::chrono::steady_clock::now();
+    if (!conn->websocket->onData(conn, conn->buffer) || peerClosed) {
+        removeDetached(conn);
+    }
+}
+
+bool EventLoop::sendBuffer(Connection* conn, const std::shared_ptr<const std::string>& data)
+{
+    size_t offset = 0;
+    if (conn->output.empty()) {
+        ssize_t r = send(conn->fd, data->data(), data->size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (r < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return false;
+            r = 0;
+        }
+        if (r > 0) conn->lastWrite = std::chrono::steady_clock::now();
+        if ((size_t)r == data->size()) return true;
+        offset = r;
+    }
+    else if (conn->outputBytes + data->size() > maxPendingBytes) {
+        return false;   // 客户端接收太慢
+    }
+
+    conn->output.push_back(data);
+    conn->outputBytes += data->size();
+    if (conn->output.size() > 1) return true;
+    conn->outputOffset = offset;
+    return watchOutput(conn, true);
+}
+
+bool EventLoop::flushOutput(Connection* conn)
+{
+    while (!conn->output.empty()) {
+        iovec iov[MAX_OUTPUT_IOV];
+        int count = 0;
+        size_t offset = conn->outputOffset;
+        for (auto it = conn->output.begin(); it != conn->output.end() && count < MAX_OUTPUT_IOV; ++it) {
+            iov[count].iov_base = const_cast<char*>((*it)->data()) + offset;
+            iov[count].iov_len = (*it)->size() - offset;
+            offset = 0;
+            ++count;
+        }
+        msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t r = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            return false;
+        }
+        conn->lastWrite = std::chrono::steady_clock::now();
+
+        size_t sent = r;
+        while (sent > 0) {
+            size_t left = conn->output.front()->size() - conn->outputOffset;
+            if (sent < left) {
+                conn->outputOffset += sent;
+                break;
+            }
+            sent -= left;
+            conn->outputBytes -= conn->output.front()->size();
+            conn->output.pop_front();
+            conn->outputOffset = 0;
+        }
+    }
+    if (conn->closeAfterFlush) return false;
+    return watchOutput(conn, false);
+}
+
+void EventLoop::removeDetached(Connection* conn)
+{
+    if (conn->websocket) {
+        websockets.erase(conn);
+        conn->websocket->closed();
+    }
+    auto it = channels.find(conn->channel);
+    if (it != channels.end()) {
+        it->second.erase(conn);
+        if (it->second.empty()) channels.erase(it);
+    }
+    // 连接对象随之释放，时间轮中的 weak_ptr 失效
+    removeConnection(conn->fd);
+}
+
+void EventLoop::sendHeartbeats()
+{
+    // SSE 注释行，客户端会忽略；WebSocket 发送 ping，客户端必须回复 pong
+    static const auto comment = std::make_shared<const std::string>(":\n\n");
+    static const auto ping = std::make_shared<const std::string>(WebSocketParser::frame(WebSocketParser::OP_PING, ""));
+
+    auto now = std::chrono::steady_clock::now();
+    auto interval = std::chrono::milliseconds(heartbeatInterval);
+    heartbeats.advance(now, [&](std::weak_ptr<Connection>& item) {
+        std::shared_ptr<Connection> conn = item.lock();
+        if (!conn || !heartbeatInterval) return;
+        // SSE 按最近一次发送计算空闲时间；WebSocket 按最近一次收到数据计算，
+        // 两个间隔内没有收到任何数据（包括 pong）或者关闭帧没有回复时断开
+        bool websocket = conn->websocket != nullptr;
+        auto idle = now - (websocket ? conn->lastActive : conn->lastWrite);
+        if (websocket && (conn->websocket->closeSent_ || idle >= 2 * interval)) {
+            removeDetached(conn.get());
+            return;
+        }
+        if (idle < interval) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(interval - idle).count();
+            heartbeats.schedule(item, (size_t)wait);
+            return;
+        }
+        if (!sendBuffer(conn.get(), websocket ? ping : comment)) {
+            removeDetached(conn.get());
+            return;
+        }
+        heartbeats.schedule(item, heartbeatInterval);
+    });
+}
@@ -1,14 +1,21 @@
 #include "FlaskCpp/FlaskCpp.h"
+#include "FlaskCpp/utils/responseWriter.h"
 #include <cstdlib>
 #include <csignal>
+#include <pthread.h>
+#include <sched.h>
 #include <thread>
 #include <atomic>
 #include <sys/select.h>
+#include <poll.h>
+#include <sys/uio.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #include <chrono>
 #include <ctime>
 #include <iomanip>
+#include <stdexcept>
 #include <atomic>
 
 
@@ -56,20 +63,119 @@ static inline std::string url_decode(const std::string& encoded_str) {
     return decoded_str;
 }
 
-static inline bool stringStartsWith(std::string str_, const std::string prefix)
+// 客户端socket是非阻塞的，缓冲区满时等待可写，直到全部发送或超时
+static bool sendAll(int fd, const char* data, size_t size, int timeout_ms=30000)
 {
-    size_t str_len = str_.length();
-    size_t prefix_len = prefix.length();
-    if (prefix_len > str_len) return false;
-    return str_.find(prefix) == 0;
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t n = send(fd, data + sent, size - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd pfd = {fd, POLLOUT, 0};
+            if (poll(&pfd, 1, timeout_ms) <= 0) return false;
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+// 条件请求只对 GET 和 HEAD 返回304
+static bool notModified(const HttpParser& parser, const std::string& method,
+                        std::string_view etag, std::time_t lastModified)
+{
+    if (method != "GET" && method != "HEAD") return false;
+    return flaskcpp::isNotModified(parser.header("If-None-Match"), parser.header("If-Modified-Since"),
+                                   etag, lastModified);
+}
+
+// 响应头 "\r\nName: value" 中的值，没有时返回空
+static std::string_view headerValue(const std::string& header, std::string_view name)
+{
+    size_t headerEnd = header.find("\r\n\r\n");
+    std::string key = "\r\n" + std::string(name) + ": ";
+    size_t pos = header.find(key);
+    if (pos == std::string::npos || pos >= headerEnd) return std::string_view();
+    pos += key.size();
+    return std::string_view(header).substr(pos, header.find("\r\n", pos) - pos);
+}
+
+// 主体足够大、类型适合压缩且还没有压缩的文本/JSON响应
+static bool isCompressible(const flaskcpp::Response& resp, const flaskcpp::CompressionOptions& options)
+{
+    if (options.level <= 0 || resp.body.size() < options.minSize) return false;
+    if (!headerValue(resp.text, "Content-Encoding").empty()) return false;
+    return flaskcpp::isCompressibleType(headerValue(resp.text, "Content-Type"));
 }
 
-static inline bool stringEndsWith(std::string str_, const std::string suffix)
+// 压缩版本的 ETag："abc" -> "abc-gzip"
+static std::string encodedETag(const std::string& etag, flaskcpp::ContentEncoding encoding)
 {
-    size_t str_len = str_.length();
-    size_t suffix_len = suffix.length();
-    if (suffix_len > str_len) return false;
-    return (str_.find(suffix, str_len - suffix_len) == (str_len - suffix_len));
+    if (etag.size() < 2 || etag.back() != '"' || encoding == flaskcpp::ENCODING_IDENTITY) return etag;
+    return etag.substr(0, etag.size() - 1) + "-" + flaskcpp::encodingName(encoding) + "\"";
+}
+
+// 压缩主体并改写 Content-Length 和 ETag，加上 Content-Encoding；不压缩时只加上 Vary
+static void compressResponse(flaskcpp::Response& resp, flaskcpp::ContentEncoding encoding, int level)
+{
+    std::string& header = resp.text;
+    size_t headerEnd = header.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) return;
+
+    std::string extra = "Vary: Accept-Encoding\r\n";
+    std::string compressed;
+    if (flaskcpp::compress(resp.body, compressed, encoding, level)) {
+        auto replaceValue = [&](std::string_view name, const std::string& value) {
+            std::string_view old = headerValue(header, name);
+            if (old.empty()) return;
+            header.replace(old.data() - header.data(), old.size(), value);
+        };
+        replaceValue("Content-Length", std::to_string(compressed.size()));
+        if (!resp.etag.empty()) {
+            resp.etag = encodedETag(resp.etag, encoding);
+            replaceValue("ETag", resp.etag);
+        }
+        resp.body = std::move(compressed);
+        extra += "Content-Encoding: ";
+        extra += flaskcpp::encodingName(encoding);
+        extra += "\r\n";
+    }
+    header.insert(header.find("\r\n\r\n") + 2, extra);
+}
+
+static bool sendAllv(int fd, iovec* iov, int iovcnt, int timeout_ms=30000)
+{
+    while (iovcnt > 0) {
+        // 与 sendAll 一样使用 MSG_NOSIGNAL，客户端断开时不会触发 SIGPIPE
+        msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                pollfd pfd = {fd, POLLOUT, 0};
+                if (poll(&pfd, 1, timeout_ms) <= 0) return false;
+                continue;
+            }
+            return false;
+        }
+        // 跳过已经完整发送的部分
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
 }
 
 std::string strfnowtime(std::string format="%Y-%m-%d %H:%M:%S")
@@ -119,8 +225,8 @@ std::vector<char> readFileBytesData(const std::string& file_path, bool verbose)
 }
 
 // 构造函数
-FlaskCpp::FlaskCpp(std::string server_name, size_t minThreads, size_t maxThreads)
-:running(false), threadPool(minThreads, maxThreads), server_name(server_name)
+FlaskCpp::FlaskCpp(std::string server_name, size_t minThreads, size_t maxThreads, size_t acceptors)
+:running(false), threadPool(minThreads, maxThreads), server_name(server_name), acceptors(acceptors)
 {
     verbose = verbose_default;
     if (flask_first && verbose)
@@ -148,6 +254,11 @@ FlaskCpp::FlaskCpp(int port, bool verbose, bool enableHotReload, size_t minThrea
     }
 }
 
+FlaskCpp::~FlaskCpp()
+{
+    if (serverThread.joinable()) stop();
+}
+
 void FlaskCpp::setSecretKey(const std::string& key)
 {
     serialzer.setKey(key);
@@ -188,11 +299,149 @@ void FlaskCpp::setTemplateChangedCallback(TemplateEngine::FileChangedCallback ca
     };
 }
 
+// 所有实例共用的代数计数器，同一地址上先后创建的实例也不会得到相同的代数
+static std::atomic<uint64_t> routeGenerations{0};
+
+const FlaskCpp::RouteTable& FlaskCpp::routes()
+{
+    struct Cached {
+        const FlaskCpp* owner = nullptr;
+        uint64_t generation = 0;
+        std::shared_ptr<const RouteTable> table;
+    };
+    thread_local Cached cached;
+
+    if (cached.owner != this || cached.generation != routeGeneration.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(routeMutex);
+        cached.owner = this;
+        cached.generation = routeGeneration.load(std::memory_order_relaxed);
+        cached.table = routeTable;
+    }
+    return *cached.table;
+}
+
+void FlaskCpp::updateRoutes(const std::function<void(RouteTable&)>& update)
+{
+    std::lock_guard<std::mutex> lock(routeMutex);
+    auto table = std::make_shared<RouteTable>(*routeTable);
+    update(*table);
+    routeTable = std::move(table);
+    routeGeneration.store(++routeGenerations, std::memory_order_release);
+}
+
+void FlaskCpp::checkInserted(bool inserted, const std::string& path)
+{
+    if (inserted) return;
+    std::ostringstream oss;
+    oss << "Route not added, too many parameters (max " << RouteTree<UniteRoute>::MAX_PARAMS << "): " << path;
+    if (logger)
+    {
+        logger({4, oss.str(), __LINE__, __FILE__, __func__});
+    }
+    else
+        std::cerr << "[\033[32m" << strfnowtime() << "\033[0m] " << oss.str() << std::endl;
+    throw std::invalid_argument(oss.str());
+}
+
 void FlaskCpp::route2(const std::string& path, UniteHandler handler)
 {
+    addUniteRoute(path, {std::move(handler), std::nullopt});
+}
+
+void FlaskCpp::route2(const std::string& path, UniteHandler handler, const RouteOptions& options)
+{
+    addUniteRoute(path, {std::move(handler), options});
+}
+
+void FlaskCpp::setCompression(const flaskcpp::CompressionOptions& options)
+{
+    compression = options;
+}
+
+void FlaskCpp::setMaxBodySize(size_t bytes)
+{
+    maxBodySize = bytes;
+}
+
+void FlaskCpp::routeSSE(const std::string& path, SSEHandler handler)
+{
+    updateRoutes([&](RouteTable& table) {
+        checkInserted(table.SSE_ROUTES.insert(path, std::move(handler)), path);
+    });
+    if (logger)
+    {
+        std::ostringstream oss;
+        oss << "SSE route added: " << path;
+        logger({2, oss.str(), __LINE__, __FILE__, __func__});
+    }
+    else if (verbose) {
+        std::cout << "[\033[32m" << strfnowtime() << "\033[0m] \033[32m\033[1m" << "SSE route added\033[0m: " << path << std::endl;
+    }
+}
+
+// 每行数据一个 data: 字段，空行结束事件
+static std::string formatEvent(const std::string& data, const std::string& event)
+{
+    std::string out;
+    out.reserve(data.size() + event.size() + 16);
+    if (!event.empty()) {
+        out += "event: ";
+        out += event;
+        out += '\n';
+    }
+    size_t pos = 0;
+    while (true) {
+        size_t nl = data.find('\n', pos);
+        size_t end = nl == std::string::npos ? data.size() : nl;
+        size_t lineEnd = (end > pos && data[end - 1] == '\r') ? end - 1 : end;
+        out += "data: ";
+        out.append(data, pos, lineEnd - pos);
+        out += '\n';
+        if (nl == std::string::npos) break;
+        pos = nl + 1;
+    }
+    out += '\n';
+    return out;
+}
+
+void FlaskCpp::publish(const std::string& channel, const std::string& data, const std::string& event)
+{
+    auto buffer = std::make_shared<const std::string>(formatEvent(data, event));
+    std::lock_guard<std::mutex> lock(loopMutex);
+    for (auto& loop: eventLoops) {
+        loop->publish(channel, buffer);
+    }
+}
+
+void FlaskCpp::setSSEHeartbeat(size_t ms)
+{
+    sseHeartbeat = ms;
+}
+
+void FlaskCpp::routeWebSocket(const std::string& path, WebSocketOpenHandler on_open,
+                              WebSocketMessageHandler on_message, WebSocketCloseHandler on_close)
+{
+    updateRoutes([&](RouteTable& table) {
+        checkInserted(table.WS_ROUTES.insert(path, {std::move(on_open), std::move(on_message), std::move(on_close)}), path);
+    });
+    if (logger)
+    {
+        std::ostringstream oss;
+        oss << "WebSocket route added: " << path;
+        logger({2, oss.str(), __LINE__, __FILE__, __func__});
+    }
+    else if (verbose) {
+        std::cout << "[\033[32m" << strfnowtime() << "\033[0m] \033[32m\033[1m" << "WebSocket route added\033[0m: " << path << std::endl;
+    }
+}
+
+void FlaskCpp::addUniteRoute(const std::string& path, UniteRoute route)
+{
+    updateRoutes([&](RouteTable& table) {
+        checkInserted(table.ROUTES.insert(path, route), path);
+    });
     if (path.find("<") != path.npos && path.find(">") != path.npos)
     {
-        paramROUTES.push_back({path, handler});
         if (logger)
         {
             std::ostringstream oss;
@@ -207,9 +456,6 @@ void FlaskCpp::route2(const std::string& path, UniteHandler handler)
     }
     else
     {
-        ROUTES[path] = [handler](const RequestData& req) {
-            return handler(req);
-        };
         if (logger)
         {
             std::ostringstream oss;
@@ -225,9 +471,11 @@ void FlaskCpp::route2(const std::string& path, UniteHandler handler)
 
 void FlaskCpp::route(const std::string& path, SimpleHandler handler) [[deprecated]] 
 {
-    routes[path] = [handler](const RequestData& req) {
-        return handler(req);
-    };
+    updateRoutes([&](RouteTable& table) {
+        checkInserted(table.routes.insert(path, [handler](const RequestData& req) {
+            return handler(req);
+        }), path);
+    });
     if (logger)
     {
         std::ostringstream oss;
@@ -241,9 +489,11 @@ void FlaskCpp::route(const std::string& path, SimpleHandler handler) [[deprecate
 
 void FlaskCpp::routeFile(const std::string& path, FlaskFileHandler handler) [[deprecated]] 
 {
-    file_routes[path] = [handler](const RequestData& req) {
-        return handler(req);
-    };
+    updateRoutes([&](RouteTable& table) {
+        table.file_routes[path] = [handler](const RequestData& req) {
+            return handler(req);
+        };
+    });
     if (logger)
     {
         std::ostringstream oss;
@@ -264,7 +514,9 @@ std::vector<std::string> FlaskCpp::getAllTemplateNames()
 
 void FlaskCpp::routeParam(const std::string& pattern, ComplexHandler handler) [[deprecated]]
 {
-    paramRoutes.push_back({pattern, handler});
+    updateRoutes([&](RouteTable& table) {
+        checkInserted(table.routes.insert(pattern, handler), pattern);
+    });
     if (logger)
     {
         std::ostringstream oss;
@@ -356,6 +608,43 @@ void FlaskCpp::setCheckTaskDuration(size_t ms)
     check_duration = ms?ms:1;
 }
 
+void FlaskCpp::setAcceptors(size_t n)
+{
+    acceptors = n;
+}
+
+void FlaskCpp::setBacklog(int backlog)
+{
+    this->backlog = backlog > 0 ? backlog : SOMAXCONN;
+}
+
+void FlaskCpp::setKeepAlive(size_t idle_timeout_ms, size_t max_requests)
+{
+    keepAliveTimeout = idle_timeout_ms;
+    maxKeepAliveRequests = max_requests;
+}
+
+void FlaskCpp::setUploadDir(const std::string& dir)
+{
+    uploadDir = dir;
+}
+
+void FlaskCpp::setUploadSink(UploadSink sink)
+{
+    uploadSink = sink;
+}
+
+void FlaskCpp::setStaticCache(size_t maxBytes, size_t smallFileLimit, int checkIntervalMs)
+{
+    staticCache.setLimits(maxBytes, smallFileLimit);
+    staticCache.setCheckInterval(checkIntervalMs);
+}
+
+flaskcpp::StaticCache::Stats FlaskCpp::staticCacheStats() const
+{
+    return staticCache.stats();
+}
+
 void FlaskCpp::addCheckTask(TemplateEngine::CheckTask task)
 {
     templateEngine.addCheckTask(task);
@@ -456,17 +745,14 @@ void FlaskCpp::runAsync() {
         }
     }
 
-    // 将服务器启动任务添加到高优先级线程池
-    // 假设0是最高优先级
-    threadPool.enqueue(0, [this](){
+    // 事件循环在单独的线程中运行，分发的请求进入线程池的共享队列
+    serverThread = std::thread([this](){
         this->run();
     });
-
-    
 }
 
-void FlaskCpp::run() {
-    int serverSocket = socket(AF_INET6, SOCK_STREAM, 0);
+int FlaskCpp::createListenSocket(bool reusePort) {
+    int serverSocket = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (serverSocket == -1) {
         if (logger)
         {
@@ -477,21 +763,23 @@ void FlaskCpp::run() {
         else
             std::cerr << "[\033[32m" << strfnowtime() << "\033[0m] " << "Failed to create socket." << std::endl;
         running.store(false);
-        return;
+        return -1;
     }
 
     int opt = 0;
     setsockopt(serverSocket, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt));
     opt = 1;
     setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reusePort) {
+        // 多个监听socket绑定同一端口，由内核在它们之间分配连接
+        setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    }
     
     sockaddr_in6 serverAddr = {};
     serverAddr.sin6_family = AF_INET6;
     serverAddr.sin6_addr = in6addr_any;
     serverAddr.sin6_port = htons(port);
 
-    bind_success = true;
-
     if (bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == -1) {
         if (logger)
         {
@@ -505,10 +793,10 @@ void FlaskCpp::run() {
         bind_success = false;
         // running.store(false);
         // stop();
-        return;
+        return -1;
     }
 
-    if (listen(serverSocket, 100) == -1) { // 增加Backlog以获得更大的负载
+    if (listen(serverSocket, backlog) == -1) {
         if (logger)
         {
             std::ostringstream oss;
@@ -521,7 +809,24 @@ void FlaskCpp::run() {
         bind_success = false;
         // running.store(false);
         // stop();
-        return;
+        return -1;
+    }
+
+    return serverSocket;
+}
+
+void FlaskCpp::run() {
+    size_t numLoops = acceptors ? acceptors : std::max(1u, std::thread::hardware_concurrency());
+
+    bind_success = true;
+    std::vector<int> serverSockets;
+    for (size_t i = 0; i < numLoops; ++i) {
+        int fd = createListenSocket(numLoops > 1);
+        if (fd < 0) {
+            for (int s: serverSockets) close(s);
+            return;
+        }
+        serverSockets.push_back(fd);
     }
 
     if (logger)
@@ -540,84 +845,90 @@ void FlaskCpp::run() {
     if (logger)
     {
         std::ostringstream oss;
-        oss << "Server is running on http://0.0.0.0:" << port;
+        oss << "Server is running on http://0.0.0.0:" << port << " (" << numLoops << " acceptor(s))";
         logger({1, oss.str(), __LINE__, __FILE__, __func__});
     }
     else if (verbose) {
-        std::cout << "[\033[32m" << strfnowtime() << "\033[0m] " << "Server is running on \033[32mhttp://0.0.0.0:" << port << "\033[0m" << std::endl;
+        std::cout << "[\033[32m" << strfnowtime() << "\033[0m] " << "Server is running on \033[32mhttp://0.0.0.0:" << port 
+                  << "\033[0m (" << numLoops << " acceptor(s))" << std::endl;
     }
 
-    while (running.load()) {  // 支持服务器停止的循环
-        sockaddr_in6 clientAddr;
-        socklen_t clientLen = sizeof(clientAddr);
-        int clientSocket = accept(serverSocket, (sockaddr*)&clientAddr, &clientLen);
-        if (clientSocket == -1) {
-            if (running.load()) { // 检查服务器是否已停止
-                if (logger)
-                {
-                    std::ostringstream oss;
-                    oss << "Failed to accept connection.";
-                    logger({4, oss.str(), __LINE__, __FILE__, __func__});
-                }
-                else 
-                    std::cerr << "[\033[32m" << strfnowtime() << "\033[0m] " << "Failed to accept connection." << std::endl;
-            }
-            continue;
-        }
-
-        // 设置读取第一个数据块的超时（5秒）
-        struct timeval timeout;
-        timeout.tv_sec = 5;
-        timeout.tv_usec = 0;
-        setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
-
-        // 读取查询方法的前4096字节
-        char buffer[4096];
-        ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer), MSG_PEEK);
-        std::string requestSample;
-        if (bytesRead > 0) {
-            requestSample = std::string(buffer, bytesRead);
-        }
-
-        // 从第一行提取查询方法
-        std::string method = "GET"; // 默认GET
-        size_t firstLineEnd = requestSample.find("\r\n");
-        if (firstLineEnd != std::string::npos) {
-            std::string firstLine = requestSample.substr(0, firstLineEnd);
-            std::istringstream iss(firstLine);
-            iss >> method;
-        }
-
-        // 根据查询方法设置优先级
-        int priority = 5; // 默认平均优先级
+    // 根据查询方法设置优先级
+    auto dispatch = [this](std::shared_ptr<Connection> conn) {
+        std::string_view method = conn->parser.method();
+        int priority = 4; // 其他方法的优先级非常低
         if (method == "GET") {
             priority = 1; // Get高优先级
         } else if (method == "POST") {
             priority = 2; // Post平均优先级
         } else if (method == "PUT" || method == "DELETE") {
             priority = 3; // 低优先级的put和delete
-        } else {
-            priority = 4; // 其他方法的优先级非常低
         }
 
-        // if (verbose) {
-        //     std::cout << "Request Method: " << method << " - Assigned Priority: " << priority << std::endl;
-        // }
+        // 将客户端处理添加到具有特定优先级的线程池
+        try {
+            threadPool.post(priority, [this, conn]() {
+                this->handleClient(conn);
+            });
+        } catch (const std::exception& e) {
+            conn->loop->closeConnection(conn);  // 线程池已停止
+        }
+    };
 
-        char clientIP[INET6_ADDRSTRLEN];
-        inet_ntop(AF_INET6, &clientAddr.sin6_addr, clientIP, INET6_ADDRSTRLEN);
+    // multipart/form-data 主体流式解析，文件直接写入磁盘
+    auto multipartFactory = [this](const HttpParser& parser) -> std::unique_ptr<MultipartParser> {
+        std::string boundary = MultipartParser::boundaryOf(parser.header("Content-Type"));
+        if (boundary.empty()) return nullptr;
+        return std::make_unique<MultipartParser>(boundary, uploadDir, uploadSink);
+    };
 
-        bool fromIPV4 = stringStartsWith(clientIP, "::ffff:");
+    // 在接收主体之前按路由检查大小限制
+    auto bodyLimit = [this](const HttpParser& parser) -> size_t {
+        std::map<std::string, std::string> params;
+        const UniteRoute* route = routes().ROUTES.match(parser.path(), params);
+        if (route && route->options && route->options->maxBodySize) return route->options->maxBodySize;
+        return maxBodySize;
+    };
 
-        // 将客户端处理添加到具有特定优先级的线程池
-        threadPool.enqueue(priority, [this, clientSocket, clientIP, fromIPV4]() {
-            this->handleClient(clientSocket, std::string(fromIPV4?clientIP+7:clientIP));
-        });
+    std::vector<EventLoop*> loops;
+    {
+        std::lock_guard<std::mutex> lock(loopMutex);
+        eventLoops.clear();
+        for (int fd: serverSockets) {
+            eventLoops.emplace_back(new EventLoop(fd, dispatch));
+            eventLoops.back()->setIdleTimeout(keepAliveTimeout);
+            eventLoops.back()->setMultipartFactory(multipartFactory);
+            eventLoops.back()->setBodyLimit(bodyLimit);
+            eventLoops.back()->setHeartbeatInterval(sseHeartbeat);
+            if (!running.load()) eventLoops.back()->stop();
+            loops.push_back(eventLoops.back().get());
+        }
+    }
+
+    // 事件循环负责accept和读取，只有完整的请求才会交给线程池
+    if (loops.size() == 1) {
+        loops[0]->loop();
+        return;
     }
 
-    close(serverSocket);
+    // 每个监听socket由独立的事件循环线程负责，并绑定到各自的CPU核心
+    std::vector<std::thread> loopThreads;
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < loops.size(); ++i) {
+        loopThreads.emplace_back([loop = loops[i]]() {
+            loop->loop();
+        });
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(i % cores, &cpuset);
+        pthread_setaffinity_np(loopThreads.back().native_handle(), sizeof(cpu_set_t), &cpuset);
+    }
+    for (auto& t: loopThreads) {
+        t.join();
+    }
 }
 
+
 void FlaskCpp::run(int port, bool verbose, bool enableHotReload)
 {
     this->port = port;
@@ -656,15 +967,15 @@ void FlaskCpp::stop() {
 
     // std::cout << __LINE__ << std::endl;
 
-    // 创建与服务器套接字的连接以终止Accept锁
-    int dummySocket = socket(AF_INET, SOCK_STREAM, 0);
-    if(dummySocket != -1){
-        sockaddr_in serverAddr = {};
-        serverAddr.sin_family = AF_INET;
-        serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
-        serverAddr.sin_port = htons(port);
-        connect(dummySocket, (sockaddr*)&serverAddr, sizeof(serverAddr));
-        close(dummySocket);
+    // 唤醒事件循环使其退出
+    {
+        std::lock_guard<std::mutex> lock(loopMutex);
+        for (auto& loop: eventLoops) loop->stop();
+    }
+
+    // 等待事件循环退出，之后不会再有新的请求交给线程池
+    if (serverThread.joinable() && serverThread.get_id() != std::this_thread::get_id()) {
+        serverThread.join();
     }
 
     // std::cout << __LINE__ << std::endl;
@@ -694,6 +1005,17 @@ std::string FlaskCpp::renderTemplate(const std::string& templateName, const Temp
     return templateEngine.render(templateName, context);
 }
 
+flaskcpp::Response FlaskCpp::streamTemplate(const std::string& templateName, TemplateEngine::Context context,
+                                            std::vector<std::pair<std::string, std::string>> extra_headers) {
+    if (!templateEngine.hasTemplate(templateName)) return flaskcpp::Response();
+
+    // 处理函数返回后才开始渲染，上下文由响应持有
+    auto ctx = std::make_shared<TemplateEngine::Context>(std::move(context));
+    return flaskcpp::send_stream([this, templateName, ctx](const flaskcpp::StreamWriter& write) {
+        templateEngine.render(templateName, *ctx, write);
+    }, "", std::move(extra_headers));
+}
+
 std::string FlaskCpp::jump_to(const std::string& route_, const std::string& msg, size_t delay)
 {
     std::string html_string = R"(<!DOCTYPE html>
@@ -714,27 +1036,19 @@ std::string FlaskCpp::buildResponse(const std::string& status_code,
                                     const std::string& content_type,
                                     const std::string& body,
                                     const std::vector<std::pair<std::string, std::string>>& extra_headers) {
-    std::ostringstream response;
-    response << "HTTP/1.1 " << status_code << "\r\n";
-    response << "Content-Type: " << content_type;
-
-    // 为文本内容类型添加charset=utf-8
-    if (content_type.find("text/") != std::string::npos || content_type.find("application/json") != std::string::npos) {
-        response << "; charset=utf-8";
-    }
-    response << "\r\n";
-
-    response << "Content-Length: " << body.size() << "\r\n";
-
-    // 添加其他标题，包括多个设置cookie
-    for (const auto& header : extra_headers) {
-        if (header.first.empty()) continue;
-        response << header.first << ": " << header.second << "\r\n";
-    }
-
-    response << "Connection: close\r\n\r\n";
-    response << body;
-    return response.str();
+    // status_code 形如 "200 OK"，可以带任意原因短语
+    std::string response;
+    response.reserve(256 + body.size());
+    response += "HTTP/1.1 ";
+    response += status_code;
+    response += "\r\n";
+    response += flaskcpp::dateHeader();
+    flaskcpp::ResponseWriter(response).contentType(content_type)
+                                      .contentLength(body.size())
+                                      .headers(extra_headers)
+                                      .endHeaders()
+                                      .body(body);
+    return response;
 }
 
 template <typename T>
@@ -742,37 +1056,39 @@ std::string FlaskCpp::buildResponse(const std::string& status_code,
                                     int file_type, std::vector<T> file_data,
                                     const std::vector<std::pair<std::string, std::string>>& extra_headers)
 {
-    std::ostringstream response;
-    response << "HTTP/1.1 " << status_code << "\r\n";
+    size_t size = file_data.size() * sizeof(T);
+    std::string response;
+    response.reserve(256 + size);
+    response += "HTTP/1.1 ";
+    response += status_code;
+    response += "\r\n";
+    response += flaskcpp::dateHeader();
+
+    flaskcpp::ResponseWriter writer(response);
     if (file_type >=0 && file_type < __flaskFileTypeMap__.size())
     {
-        response << "Content-Type: " << __flaskFileTypeMap__[file_type] << "\r\n";
+        writer.header("Content-Type", __flaskFileTypeMap__[file_type]);
     }
     else
     {
-        response << "Content-Type: application/octet-stream\r\n";
+        writer.header("Content-Type", "application/octet-stream");
     }
-        
-    response << "Content-Length: " << file_data.size() << "\r\n";
-    
-    
+    writer.contentLength(size);
+
     bool has_cache_control = false;
     for (const auto& header : extra_headers) {
         if (header.first.empty()) continue;
         if (header.first == "Cache-Control") has_cache_control = true;
-        response << header.first << ": " << header.second << "\r\n";
+        writer.header(header.first, header.second);
     }
     if (!has_cache_control)
     {
-        response << "Cache-Control: public, max-age=3600\r\n";
+        writer.header("Cache-Control", "public, max-age=3600");
     }
-    
-    response << "Connection: close\r\n\r\n";
-    
+
     // 将二进制数据写入响应体
-    response.write((char*)file_data.data(), file_data.size() * sizeof(T));
-    
-    return response.str();
+    writer.endHeaders().body(std::string_view((const char*)file_data.data(), size));
+    return response;
 }
 
 template std::string FlaskCpp::buildResponse<char>(
@@ -792,40 +1108,36 @@ template <typename T>
 std::string FlaskCpp::send_file(std::vector<T> file_data, std::string file_name, bool as_attachment,
                                 const std::vector<std::pair<std::string, std::string>>& extra_headers)
 {
-    std::ostringstream response;
-    response << "HTTP/1.1 200 OK\r\n";
-    if (file_data.size())
-    {
-        response << "Content-Type: " << getFileTypeString(-2, file_name) << "\r\n";
-    }
-    else
+    if (!file_data.size())
     {
         return generate404Error();
     }
-        
-    response << "Content-Length: " << file_data.size() << "\r\n";
-    
+
+    size_t size = file_data.size() * sizeof(T);
+    std::string response;
+    response.reserve(256 + size);
+    flaskcpp::ResponseWriter writer(response);
+    writer.status(200)
+          .header("Content-Type", getFileTypeString(-2, file_name))
+          .contentLength(size);
 
     auto fileExtraHeader = genFileExtraSettings(file_name, as_attachment);
-    response << fileExtraHeader.first << ": " << fileExtraHeader.second;
-    
+    writer.header(fileExtraHeader.first, fileExtraHeader.second);
+
     bool has_cache_control = false;
     for (const auto& header : extra_headers) {
         if (header.first.empty()) continue;
         if (header.first == "Cache-Control") has_cache_control = true;
-        response << header.first << ": " << header.second << "\r\n";
+        writer.header(header.first, header.second);
     }
     if(!has_cache_control)
     {
-        response << "Cache-Control: public, max-age=3600\r\n";
+        writer.header("Cache-Control", "public, max-age=3600");
     }
-    
-    response << "Connection: close\r\n\r\n";
-    
+
     // 将二进制数据写入响应体
-    response.write((char*)file_data.data(), file_data.size() * sizeof(T));
-    
-    return response.str();
+    writer.endHeaders().body(std::string_view((const char*)file_data.data(), size));
+    return response;
 }
 
 
@@ -910,98 +1222,204 @@ std::string FlaskCpp::deleteCookie(const std::string& name,
     return cookie.str();
 }
 
-void FlaskCpp::handleClient(int clientSocket, const std::string& clientIP) {
+void FlaskCpp::handleClient(std::shared_ptr<Connection> conn) {
+    // 持久连接：如果缓冲区中已经有下一个完整的请求（pipelining），在当前线程继续处理
+    while (true) {
+        bool keepAlive = handleRequest(conn);
+        // SSE 和 WebSocket 连接已经交给事件循环
+        if (conn->sse || conn->websocket || conn->fd < 0) return;
+
+        // 删除已处理的请求，继续解析剩余数据
+        size_t size = std::min(conn->parser.messageSize(), conn->buffer.size());
+        conn->buffer.erase(0, size);
+        conn->parser.reset();
+        conn->multipart.reset();
+        if (!keepAlive) break;
+
+        HttpParser::State state = conn->loop->parseRequest(*conn);
+        if (state == HttpParser::STATE_ERROR) break;
+        if (state != HttpParser::STATE_COMPLETE) {
+            // 交还给事件循环，等待下一个请求
+            conn->loop->resume(conn);
+            return;
+        }
+    }
+    conn->loop->closeConnection(conn);
+}
+
+void FlaskCpp::upgradeWebSocket(const std::shared_ptr<Connection>& conn, const WebSocketRoute& route,
+                                RequestData& reqData, int& status)
+{
+    const HttpParser& parser = conn->parser;
+    std::string connection(parser.header("Connection"));
+    std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+    std::string_view key = parser.header("Sec-WebSocket-Key");
+    if (parser.method() != "GET" || parser.version() != "HTTP/1.1" || key.empty() ||
+        !strEqualsIgnoreCase(parser.header("Upgrade"), "websocket") ||
+        connection.find("upgrade") == std::string::npos ||
+        parser.header("Sec-WebSocket-Version") != "13")
+    {
+        // 告诉客户端支持的协议版本
+        status = 400;
+        sendResponse(conn->fd, flaskcpp::ResponseWriter::build(400, "text/plain", "Bad Request",
+                                                               {{"Sec-WebSocket-Version", "13"}}));
+        return;
+    }
+
+    std::string header;
+    flaskcpp::ResponseWriter(header).status(101)
+                                    .header("Upgrade", "websocket")
+                                    .header("Connection", "Upgrade")
+                                    .header("Sec-WebSocket-Accept", WebSocketParser::acceptKey(key))
+                                    .endHeaders();
+    if (!sendAll(conn->fd, header.data(), header.size())) return;
+    status = 101;
+
+    // 请求数据只在 onOpen 中使用，之后随回调一起释放
+    auto request = std::make_shared<RequestData>(std::move(reqData));
+    WebSocketOpenHandler onOpen = route.onOpen;
+    auto websocket = std::make_shared<WebSocket>(conn,
+        [onOpen, request](const WebSocketPtr& ws) {
+            if (onOpen) onOpen(ws, *request);
+        },
+        route.onMessage, route.onClose);
+    conn->loop->upgrade(conn, std::move(websocket));
+}
+
+bool FlaskCpp::isKeepAlive(const HttpParser& parser, size_t served)
+{
+    if (!keepAliveTimeout || served >= maxKeepAliveRequests || !running.load()) return false;
+    if (parser.mustClose()) return false;
+
+    // HTTP/1.0 默认关闭连接，HTTP/1.1 默认保持连接
+    bool keepAlive = parser.version() != "HTTP/1.0";
+    std::string_view connection = parser.header("Connection");
+    if (!connection.empty()) {
+        std::string value(connection);
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        if (value.find("close") != std::string::npos) keepAlive = false;
+        else if (value.find("keep-alive") != std::string::npos) keepAlive = true;
+    }
+    return keepAlive;
+}
+
+bool FlaskCpp::handleRequest(const std::shared_ptr<Connection>& conn) {
+    int clientSocket = conn->fd;
+    const std::string& clientIP = conn->ip;
     int status = 200;
+    bool keepAlive = false;
     std::string method="Unknown", path="Unknown";
+    // HEAD 请求只发送响应头，Content-Length 等字段与 GET 相同
+    const bool headOnly = conn->parser.method() == "HEAD";
     try {
-        // std::cout << 1 << std::endl;
-        std::string requestStr = readRequest(clientSocket);
-        // std::cout << 2 << std::endl;
+        // 先只解析请求行，请求头和主体在匹配到处理函数后再生成
+        const HttpParser& parser = conn->parser;
         RequestData reqData;
-        parseRequest(requestStr, reqData);
+        parseRequestLine(parser, reqData);
         reqData.path = url_decode(reqData.path);
+        keepAlive = isKeepAlive(parser, ++conn->requestCount);
         // std::cout << 3 << ". " << reqData.method << "," << reqData.path << std::endl;
         
-        if (reqData.path[0] == '/')
+        if (!reqData.path.empty() && reqData.path[0] == '/')
         {
             method = reqData.method;
             path = reqData.full_path;
         }
         else
         {
-            return;
+            return false;
         }
         
 
         std::string response;
+        flaskcpp::StaticCache::EntryPtr staticFile;
+        flaskcpp::CompressionOptions routeCompression = compression;
         bool is_file=false;
         flaskcpp::FileHandler fh;
         flaskcpp::Response resp;
+        bool detached = false;      // SSE/WebSocket 的响应头已经发送（或发送失败），不再发送其他响应
 
         {
-            std::lock_guard<std::mutex> lock(routeMutex);
-
-            UniteHandler unite_handler = nullptr;
-            ComplexHandler handler = nullptr;
+            // 当前线程缓存的路由表快照，处理函数在锁外并行执行
+            const RouteTable* table = &routes();
+
+            // 在路由树中查找，参数只在匹配成功时写入 routeParams
+            const WebSocketRoute* ws_route = table->WS_ROUTES.empty() ? nullptr :
+                                             table->WS_ROUTES.match(reqData.path, reqData.routeParams);
+            const SSEHandler* sse_route = (ws_route || table->SSE_ROUTES.empty()) ? nullptr :
+                                          table->SSE_ROUTES.match(reqData.path, reqData.routeParams);
+            const UniteRoute* unite_route = (ws_route || sse_route) ? nullptr :
+                                            table->ROUTES.match(reqData.path, reqData.routeParams);
             
-            // 试图找到准确的路线。
-            auto uit = ROUTES.find(reqData.path);
-            if (uit != ROUTES.end())
+            if (ws_route)
             {
-                unite_handler = uit->second;
+                parseRequest(parser, conn->multipart.get(), reqData);
+                detached = true;
+                keepAlive = false;
+                upgradeWebSocket(conn, *ws_route, reqData, status);
             }
-            else
+            else if (sse_route)
             {
-                for (auto &pr : paramROUTES) {
-                    if (matchParamRoute(reqData.path, pr.pattern, reqData.routeParams)) {
-                        unite_handler = pr.handler;
-                        break;
-                    }
+                parseRequest(parser, conn->multipart.get(), reqData);
+                std::string channel = (*sse_route)(reqData);
+                if (channel.empty())
+                {
+                    keepAlive = sendResponse(clientSocket, generate404Error("404 NOT FOUND"), keepAlive, headOnly);
+                    status = 404;
+                }
+                else
+                {
+                    // 没有 Content-Length，事件一直发送到连接关闭
+                    std::string header;
+                    flaskcpp::ResponseWriter(header).status(200)
+                                                    .header("Content-Type", "text/event-stream")
+                                                    .header("Cache-Control", "no-cache")
+                                                    .header("X-Accel-Buffering", "no")
+                                                    .endHeaders();
+                    detached = true;
+                    keepAlive = false;
+                    if (sendAll(clientSocket, header.data(), header.size()) && !headOnly) conn->loop->subscribe(conn, channel);
                 }
             }
-            
-            
-            if (unite_handler)
+            else if (unite_route)
             {
-                resp = unite_handler(reqData);
+                parseRequest(parser, conn->multipart.get(), reqData);
+                resp = unite_route->handler(reqData);
+                if (unite_route->options) routeCompression = unite_route->options->compression;
                 if (!resp.type)
                 {
-                    sendResponse(clientSocket, generate404Error("404 NOT FOUND"));
+                    keepAlive = sendResponse(clientSocket, generate404Error("404 NOT FOUND"), keepAlive, headOnly);
                     status = 404;
                 }
             }
             // 如果新接口没有匹配，尝试匹配老接口，不建议使用
             else
             {
-                auto it = routes.find(reqData.path);
-                if (it != routes.end()) {
-                    handler = it->second;
-                } else {
-                    // 检查带有参数的路由
-                    for (auto &pr : paramRoutes) {
-                        if (matchParamRoute(reqData.path, pr.pattern, reqData.routeParams)) {
-                            handler = pr.handler;
-                            break;
-                        }
-                    }
-                }
+                const ComplexHandler* handler = table->routes.match(reqData.path, reqData.routeParams);
 
                 if (!handler) {
                     // 寻找是否是本地文件
                     FlaskFileHandler fhandler = nullptr;
-                    auto it = file_routes.find(reqData.path);
-                    if (it != file_routes.end()) {
+                    auto it = table->file_routes.find(reqData.path);
+                    if (it != table->file_routes.end()) {
                         fhandler = it->second;
                         is_file = true;
+                        parseRequest(parser, conn->multipart.get(), reqData);
                         fhandler(reqData).copyTo(fh);
                     }
                     // 检查静态文件
-                    else if (!serveStaticFile(reqData, response)) {
-                        response = generate404Error();
-                        status = 404;
+                    else {
+#ifdef ENABLE_PHP
+                        parseRequest(parser, conn->multipart.get(), reqData);
+#endif
+                        if (!serveStaticFile(reqData, parser.header("Accept-Encoding"), response, staticFile)) {
+                            response = generate404Error();
+                            status = 404;
+                        }
                     }
                 } else {
-                    response = handler(reqData);
+                    parseRequest(parser, conn->multipart.get(), reqData);
+                    response = (*handler)(reqData);
                 }
             }
         }
@@ -1020,11 +1438,36 @@ void FlaskCpp::handleClient(int clientSocket, const std::string& clientIP) {
             {
             case flaskcpp::RESP_TYPE_TEXT:
             case flaskcpp::RESP_TYPE_JSON:
-                sendResponse(clientSocket, resp.text);
+                {
+                    // 压缩后的响应使用不同的 ETag，304 按实际会发送的版本判断
+                    flaskcpp::ContentEncoding encoding = flaskcpp::ENCODING_IDENTITY;
+                    bool compressible = isCompressible(resp, routeCompression);
+                    if (compressible) encoding = flaskcpp::negotiateEncoding(parser.header("Accept-Encoding"));
+                    std::string etag = encodedETag(resp.etag, encoding);
+                    if (!etag.empty() && notModified(parser, reqData.method, etag, 0))
+                    {
+                        keepAlive = sendResponse(clientSocket, flaskcpp::ResponseWriter::buildNotModified(etag, 0), keepAlive, headOnly);
+                        status = 304;
+                        break;
+                    }
+                    if (compressible) compressResponse(resp, encoding, routeCompression.level);
+                    keepAlive = sendResponse(clientSocket, resp.text, resp.body, keepAlive, headOnly);
+                }
+                break;
+            case flaskcpp::RESP_TYPE_STREAM:
+                keepAlive = sendStream(clientSocket, resp, parser.version() != "HTTP/1.0", keepAlive, headOnly);
                 break;
             case flaskcpp::RESP_TYPE_FILE:
                 {
                     fh.init(resp.file_path, resp.file_name, resp.as_attachment);
+                    // 有预先压缩的 .gz 文件时直接发送；Range 请求总是使用原文件
+                    struct stat info;
+                    if (routeCompression.level > 0 && parser.header("Range").empty() &&
+                        flaskcpp::negotiateEncoding(parser.header("Accept-Encoding")) == flaskcpp::ENCODING_GZIP &&
+                        stat((resp.file_path + ".gz").c_str(), &info) == 0 && S_ISREG(info.st_mode))
+                    {
+                        fh.setEncoded(resp.file_path + ".gz", "gzip");
+                    }
                 }
                 break;
             case flaskcpp::RESP_TYPE_FILE_BYTES:
@@ -1039,11 +1482,11 @@ void FlaskCpp::handleClient(int clientSocket, const std::string& clientIP) {
             default:
                 if (resp.type >= 100 && resp.type < 600)
                 {
-                    sendResponse(clientSocket, resp.text);
+                    keepAlive = sendResponse(clientSocket, resp.text, resp.body, keepAlive, headOnly);
                 }
                 else
                 {
-                    sendResponse(clientSocket, generate404Error("404 NOT FOUND"));
+                    keepAlive = sendResponse(clientSocket, generate404Error("404 NOT FOUND"), keepAlive, headOnly);
                 }
                 
                 break;
@@ -1086,28 +1529,24 @@ void FlaskCpp::handleClient(int clientSocket, const std::string& clientIP) {
                 
                 if (!header_str.size() || !fh.isFileExist())
                 {
-                    sendResponse(clientSocket, generate500Error("file not found"));
+                    keepAlive = sendResponse(clientSocket, generate500Error("file not found"), keepAlive, headOnly);
+                }
+                else if (notModified(parser, reqData.method, fh.etag(), fh.lastModified()))
+                {
+                    keepAlive = sendResponse(clientSocket, flaskcpp::ResponseWriter::buildNotModified(fh.etag(), fh.lastModified()), keepAlive, headOnly);
+                    status = 304;
                 }
                 else
                 {
-                    
-                    sendResponse(clientSocket, header_str);
-                    std::vector<char> file_data(8192);
-                    size_t read_size=0;
-                    
-                    // std::cout << header_str << std::endl;
-                    while (read_size = fh.read(file_data))
-                    {
-                        if (send(clientSocket, file_data.data(), read_size, MSG_NOSIGNAL) <= 0)
-                        {
-                            break;
-                        }
-                    }
+                    // 响应头和文件内容（磁盘文件用sendfile，内存数据直接引用）一次发送
+                    flaskcpp::ResponseChain chain;
+                    appendResponse(header_str, keepAlive, chain, headOnly);
+                    if ((!headOnly && !fh.appendTo(chain)) || !chain.sendTo(clientSocket)) keepAlive = false;
                 }
 
             }
         }
-        else
+        else if (!detached)
         {
             if (is_file)
             {
@@ -1145,42 +1584,65 @@ void FlaskCpp::handleClient(int clientSocket, const std::string& clientIP) {
                 std::string header_str = fh.generateHeader();
                 if (!header_str.size() || !fh.isFileExist())
                 {
-                    sendResponse(clientSocket, generate404Error("file not found"));
+                    keepAlive = sendResponse(clientSocket, generate404Error("file not found"), keepAlive, headOnly);
                     status = 404;
                 }
+                else if (notModified(parser, reqData.method, fh.etag(), fh.lastModified()))
+                {
+                    keepAlive = sendResponse(clientSocket, flaskcpp::ResponseWriter::buildNotModified(fh.etag(), fh.lastModified()), keepAlive, headOnly);
+                    status = 304;
+                }
                 else
                 {
-                    sendResponse(clientSocket, header_str);
-                    std::vector<char> file_data(8192);
-                    size_t read_size=0;
-                    while (read_size = fh.read(file_data))
-                    {
-                        if (send(clientSocket, file_data.data(), read_size, MSG_NOSIGNAL) <= 0)
-                        {
-                            break;
-                        }
-                    }
+                    flaskcpp::ResponseChain chain;
+                    appendResponse(header_str, keepAlive, chain, headOnly);
+                    if ((!headOnly && !fh.appendTo(chain)) || !chain.sendTo(clientSocket)) keepAlive = false;
                 }
                 // sendResponse(clientSocket, )
             }
             else
             {
-                sendResponse(clientSocket, response);
+                flaskcpp::ResponseChain chain;
+                std::string notModifiedHeader;
+                if (staticFile && notModified(parser, reqData.method, staticFile->etag, staticFile->mtime.tv_sec))
+                {
+                    notModifiedHeader = flaskcpp::ResponseWriter::buildNotModified(staticFile->etag, staticFile->mtime.tv_sec);
+                    appendResponse(notModifiedHeader, keepAlive, chain, headOnly);
+                    status = 304;
+                }
+                else if (staticFile)
+                {
+                    // 缓存中的响应头和文件内容直接发送，staticFile 保持条目有效直到发送完成
+                    static const std::string keepAliveEnd = "Connection: keep-alive\r\n\r\n";
+                    static const std::string closeEnd = "Connection: close\r\n\r\n";
+                    chain.add(flaskcpp::statusLine(200));
+                    chain.add(flaskcpp::dateHeader());
+                    chain.add(staticFile->headers);
+                    chain.add(keepAlive ? keepAliveEnd : closeEnd);
+                    if (!headOnly) {
+                        if (staticFile->isCached()) chain.add(staticFile->body());
+                        else chain.addFile(staticFile->path, 0, staticFile->size);
+                    }
+                }
+                else
+                {
+                    appendResponse(response, keepAlive, chain, headOnly);
+                }
+                if (!chain.sendTo(clientSocket)) keepAlive = false;
             }
         }
         
         
-        close(clientSocket);
     } catch (std::exception& e) {
         std::string response = generate500Error(e.what());
-        sendResponse(clientSocket, response);
+        sendResponse(clientSocket, response, false, headOnly);
         status = 500;
-        close(clientSocket);
+        keepAlive = false;
     } catch (...) {
         std::string response = generate500Error("Unknown error");
-        sendResponse(clientSocket, response);
+        sendResponse(clientSocket, response, false, headOnly);
         status = 500;
-        close(clientSocket);
+        keepAlive = false;
     }
     if (logger)
     {
@@ -1194,249 +1656,51 @@ void FlaskCpp::handleClient(int clientSocket, const std::string& clientIP) {
                 << "\033[34m\033[1m" << method << " \033[0m\033[35m" << path 
                 << "\033[0m -> \033[36m" << status << "\033[0m" << std::endl;
     }
+    return keepAlive;
 }
 
-std::string FlaskCpp::readRequest(int clientSocket) {
-    std::string request;
-    char buffer[4096];
-    ssize_t bytesRead;
-    // 阅读标题
-    while ((bytesRead = recv(clientSocket, buffer, sizeof(buffer), MSG_PEEK)) > 0) {
-        std::string temp(buffer, bytesRead);
-        size_t pos = temp.find("\r\n\r\n");
-        if (pos != std::string::npos) {
-            recv(clientSocket, buffer, pos+4, 0);
-            request.append(buffer, pos+4);
-            break;
-        } else {
-            recv(clientSocket, buffer, bytesRead, 0);
-            request.append(buffer, bytesRead);
-        }
-    }
-
-    // 检查读取主体的内容长度
-    std::string headers = request;
-    size_t bodyPos = headers.find("\r\n\r\n");
-    int contentLength = 0;
-    if (bodyPos != std::string::npos) {
-        std::string headerPart = headers.substr(0, bodyPos);
-        std::istringstream iss(headerPart);
-        std::string line;
-        while (std::getline(iss, line)) {
-            line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
-            if (line.find("Content-Length:") != std::string::npos) {
-                std::string lenStr = line.substr(line.find(":")+1);
-                lenStr.erase(0,lenStr.find_first_not_of(' '));
-                contentLength = std::stoi(lenStr);
-            }
-        }
-
-        if (contentLength > 0) {
-            std::string body;
-            body.resize(contentLength);
-            int totalRead = 0;
-            while (totalRead < contentLength) {
-                ssize_t r = recv(clientSocket, &body[totalRead], contentLength - totalRead, 0);
-                if (r <= 0) break;
-                totalRead += r;
-            }
-            request.append(body);
-        }
-    }
-
-    return request;
-}
-
-
-std::vector<std::string> stringSplit(std::string str_, std::string delimiter) {
-    if (str_.empty()) return {""};
-    std::vector<std::string> tokens;
-    size_t pos = 0;
-    std::string::size_type prev_pos = 0;
-    while ((pos = str_.find(delimiter, prev_pos)) != std::string::npos) {
-        tokens.push_back(str_.substr(prev_pos, pos - prev_pos));
-        prev_pos = pos + delimiter.length();
+void FlaskCpp::parseRequestLine(const HttpParser& parser, RequestData& reqData) {
+    reqData.method = std::string(parser.method());
+    reqData.full_path = std::string(parser.target());
+    reqData.path = std::string(parser.path());
+    std::string_view queryString = parser.query();
+    if (!queryString.empty()) {
+        parseQueryString(std::string(queryString), reqData.queryParams);
     }
-    if (prev_pos < str_.length()) tokens.push_back(str_.substr(prev_pos));
-    if (stringEndsWith(str_, delimiter)) tokens.push_back("");
-    return tokens;
 }
 
-
-static inline std::string parse_file(std::string body, RequestData& req)
-{
-    // std::cout << body << std::endl;
-    bool recursive = false;
-    std::string head;
-    if (req.headers.find("Content-Type") != req.headers.end())
-    {
-        for(auto&line: stringSplit(req.headers.at("Content-Type"), "; "))
-        {
-            if (stringStartsWith(line, "boundary="))
-            {
-                head = line.substr(9);
-            }
-        }
-    }
-    if (head.empty())
-    {
-        head = "------";
-        recursive = true;
-    }
-
-    size_t loc = body.find(head);
-    if (loc == body.npos)
-    {
-        return body;
-    }
-
-    // std::cout << body.substr(loc, 500) << std::endl;
-
-    size_t line_loc = body.substr(loc).find("\n");
-    head = body.substr(loc, line_loc-1);
-
-    std::string end = head + "--";
-
-    size_t end_loc = body.substr(loc+line_loc+1).find(end);
-
-    if (end_loc == body.npos) return body;
-
-    std::string content = body.substr(loc+line_loc+1, end_loc-4);
-    std::string rest = body.substr(0, loc) + body.substr(loc+line_loc+1+end_loc+head.size()+2);
-
-    size_t disp_loc = content.find("Content-Disposition: ");
-    if (disp_loc == content.npos) return body;
-
-    size_t disp_loc_end = content.find("\r\n");
-    if (disp_loc_end == content.npos) return body;
-
-    RequestData::File f;
-    for(auto& p: stringSplit(content.substr(disp_loc + 21, disp_loc_end - disp_loc - 21), "; "))
-    {
-        // std::cout << p << std::endl;
-        if (stringStartsWith(p, "name=\""))
-        {
-            f.name = p.substr(6, p.size()-7);
-        }
-        else if (stringStartsWith(p, "filename=\""))
-        {
-            f.file_name = p.substr(10, p.size()-11);
-            // std::cout << f.file_name << std::endl;
-        }
-    }
-
-    if (strcmp(f.name.c_str(), "file") != 0)   // 如果不是文件，递归后续字符串
-    {
-        return recursive?(head + "\r\n" + content + "\r\n\r\n" + end + "\r\n" + parse_file(rest, req)):body;
-    }
-    
-    size_t type_loc = content.find("Content-Type: ", disp_loc_end);
-    if (type_loc != content.npos) 
-    {
-        size_t type_loc_end = content.find("\r\n", type_loc);
-        f.type = content.substr(type_loc + 14, type_loc_end - type_loc - 14);
-    }
-    size_t f_data_start = content.find("\r\n\r\n", type_loc);
-
-    std::string fdata = content.substr(f_data_start+4);
-
-    f.data.resize(fdata.size());
-    memcpy(f.data.data(), fdata.data(), f.data.size());
-    // size_t type_loc_end = content.find
-    req.files[f.file_name] = std::move(f);
-
-    
-    // std::cout << fdata << std::endl;
-    // std::cout << "content:-----------\n" << content  << "\nrest--------------\n" << rest << "\nend:-------------" << std::endl;
-
-    return recursive?parse_file(rest, req):rest;
-}
-
-void FlaskCpp::parseRequest(const std::string& request, RequestData& reqData) {
-    // std::cout << request.substr(0, 2000) << std::endl;
-    std::istringstream stream(request);
-    std::string firstLine;
-    std::getline(stream, firstLine);
-    firstLine.erase(std::remove(firstLine.begin(), firstLine.end(), '\r'), firstLine.end());
-    {
-        std::istringstream fls(firstLine);
-        fls >> reqData.method;
-        std::string fullPath;
-        fls >> fullPath;
-        // HTTP版本不能详细处理
-    }
-
+void FlaskCpp::parseRequest(const HttpParser& parser, MultipartParser* multipart, RequestData& reqData) {
     // Headers
-    std::string line;
-    while (std::getline(stream, line)) {
-        line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
-        if (line.empty()) break;
-        size_t colonPos = line.find(':');
-        if (colonPos != std::string::npos) {
-            std::string key = line.substr(0, colonPos);
-            std::string val = line.substr(colonPos+1);
-            while(!val.empty() && isspace((unsigned char)val.front())) val.erase(val.begin());
-            reqData.headers[key] = val;
-        }
+    for (size_t i = 0; i < parser.headerCount(); ++i) {
+        reqData.headers[std::string(parser.headerName(i))] = std::string(parser.headerValue(i));
     }
 
-    
-
-    // 余数 - 主体
+    // 主体
+    reqData.body = std::string(parser.body());
+    auto ctypeIt = reqData.headers.find("Content-Type");
+    if (ctypeIt != reqData.headers.end())
     {
-        std::string all = request;
-        size_t bodyPos = all.find("\r\n\r\n");
-        if (bodyPos != std::string::npos) {
-            std::string body = all.substr(bodyPos+4);
-            
-            
-            if (reqData.headers.find("Content-Type") != reqData.headers.end())
-            {
-                // json
-                std::string content_type = reqData.headers.at("Content-Type");
-                reqData.content_type = getContentTypeByString(content_type);
-                if (reqData.content_type == FLASK_FILE_APP_JSON)
-                {
-                    reqData.json.clear();
-                    try {
-                        reqData.json = nlohmann::json::parse(body);
-                    } catch (const nlohmann::json::parse_error& e) {
-                        std::cerr << "failed to parse JSON: " << e.what() << std::endl;
-                    }
-                    // std::cout << body << std::endl;
-
-                    // std::cout << reqData.json << std::endl;
-                    // for (auto& [key, value]: reqData.json.items())
-                    // {
-                    //     std::cout << key << ": " << value.type_name() << std::endl;
-                    // }
-                }
+        // json
+        reqData.content_type = getContentTypeByString(ctypeIt->second);
+        if (reqData.content_type == FLASK_FILE_APP_JSON)
+        {
+            reqData.json.clear();
+            try {
+                reqData.json = nlohmann::json::parse(reqData.body);
+            } catch (const nlohmann::json::parse_error& e) {
+                std::cerr << "failed to parse JSON: " << e.what() << std::endl;
             }
-
-            // parse_file
-            reqData.body = parse_file(body, reqData);
         }
     }
 
-    // 解析查询字符串
-    {
-        std::istringstream fls(firstLine);
-        std::string tmp, fullPath;
-        fls >> tmp >> fullPath;
-        size_t questionMarkPos = fullPath.find('?');
-        reqData.full_path = fullPath;
-        if (questionMarkPos != std::string::npos) {
-            reqData.path = fullPath.substr(0, questionMarkPos);
-            std::string queryString = fullPath.substr(questionMarkPos + 1);
-            parseQueryString(queryString, reqData.queryParams);
-        } else {
-            reqData.path = fullPath;
-        }
+    // multipart主体已经在接收时解析，文件在临时文件中
+    if (multipart) {
+        reqData.files = std::move(multipart->files());
+        reqData.formData = std::move(multipart->fields());
     }
 
     // 如果POST请求且Content-Type为application/x-www-form-urlencoded，则解析formData
     if (reqData.method == "POST") {
-        auto ctypeIt = reqData.headers.find("Content-Type");
         if (ctypeIt != reqData.headers.end() && ctypeIt->second.find("application/x-www-form-urlencoded") != std::string::npos) {
             parseQueryString(reqData.body, reqData.formData);
         }
@@ -1447,19 +1711,9 @@ void FlaskCpp::parseRequest(const std::string& request, RequestData& reqData) {
     if (cookieIt != reqData.headers.end()) {
         parseCookies(cookieIt->second, reqData.cookies);
 
-        // for (auto& it: reqData.cookies)
-        // {
-        //     std::cout << it.first << ": " << it.second << std::endl;
-        // }
-
         if (reqData.cookies.find("session") != reqData.cookies.end())
         {
-            // std::cout << "session: " << reqData.cookies["session"] << std::endl;
             serialzer.str2map(serialzer.loads(reqData.cookies["session"]), reqData.session);
-            // for (auto& it: reqData.session)
-            // {
-            //     std::cout << it.first << ": " << it.second << std::endl;
-            // }
         }
     }
 }
@@ -1480,107 +1734,172 @@ void FlaskCpp::parseQueryString(const std::string& queryString, std::map<std::st
     }
 }
 
-bool FlaskCpp::matchParamRoute(const std::string& path, const std::string& pattern, std::map<std::string,std::string>& routeParams) {
-    // 将path和pattern按'/'拆分
-    auto splitPath = [](const std::string&s){
-        std::vector<std::string> parts;
-        std::istringstream iss(s);
-        std::string p;
-        while(std::getline(iss, p, '/')) {
-            if (!p.empty()) parts.push_back(p);
+bool FlaskCpp::serveStaticFile(const RequestData& reqData, std::string_view acceptEncoding,
+                               [[maybe_unused]] std::string& response, flaskcpp::StaticCache::EntryPtr& file) {
+    if (reqData.path.rfind("/static/", 0) == 0) {
+        std::string filename = reqData.path.substr(8); // Убираем /static/
+        std::filesystem::path filePath = std::filesystem::current_path() / "static" / filename;
+#ifdef ENABLE_PHP
+        if (filePath.extension() == ".php") {
+            struct stat info;
+            if (stat(filePath.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) return false;
+            // 通过php-cgi支持PHP
+            std::string phpOutput = executePHP(reqData, filePath);
+            response = phpOutput;
+            return true;
         }
-        return parts;
-    };
-
-    auto pathParts = splitPath(path);
-    auto patternParts = splitPath(pattern);
-
-    if (stringStartsWith(patternParts[patternParts.size()-1], "<path:") && 
-        stringEndsWith(patternParts[patternParts.size()-1], ">"))
-    {
-        std::string paramName = patternParts[patternParts.size()-1].substr(6, patternParts[patternParts.size()-1].size()-7);
-        std::ostringstream oss;
-        for (int i=patternParts.size()-1;i<pathParts.size();++i)
-        {
-            if (i>patternParts.size()-1)
-            {
-                oss << "/";
-            }
-            oss << pathParts[i];
+#endif
+        // 文件不存在时返回nullptr；文件是否修改由缓存定期检查
+        file = staticCache.get(filePath.string());
+        if (!file) return false;
+
+        // 压缩版本（.gz 文件或压缩后缓存的内容），不适合压缩时使用原文件
+        flaskcpp::ContentEncoding encoding = flaskcpp::negotiateEncoding(acceptEncoding);
+        if (encoding != flaskcpp::ENCODING_IDENTITY && compression.level > 0) {
+            auto encoded = staticCache.getEncoded(filePath.string(), encoding, compression);
+            if (encoded) file = encoded;
         }
-        
-        routeParams[paramName] = oss.str();
+        return true;
+    }
+    return false;
+}
+
+void FlaskCpp::appendResponse(const std::string& content, bool& keepAlive, flaskcpp::ResponseChain& chain,
+                              bool headOnly) {
+    if (content.empty()) return;
 
-        size_t sz = patternParts.size()-1;
-        patternParts.resize(sz);
-        pathParts.resize(sz);
+    // 只对完整的HTTP响应头插入 Connection 字段，其他内容原样发送后关闭连接
+    size_t headerEnd = content.find("\r\n\r\n");
+    if (content.compare(0, 5, "HTTP/") != 0 || headerEnd == std::string::npos) {
+        chain.add(content);
+        keepAlive = false;
+        return;
     }
-    if (pathParts.size() != patternParts.size()) return false;
 
-    for (size_t i=0; i<pathParts.size(); i++) {
-        if (patternParts[i].size()>2 && patternParts[i].front()=='<' && patternParts[i].back()=='>') {
-            std::string paramName = patternParts[i].substr(1, patternParts[i].size()-2);
-            routeParams[paramName] = pathParts[i];
-        } else {
-            if (patternParts[i] != pathParts[i]) return false;
-        }
+    // 没有 Content-Length 且不是 chunked 编码的响应无法确定边界，只能关闭连接；1xx、204 和 304 没有主体
+    size_t lengthPos = content.find("\r\nContent-Length:");
+    size_t chunkedPos = content.find("\r\nTransfer-Encoding: chunked");
+    bool bodyless = content.size() > 12 && (content[9] == '1' || content.compare(9, 3, "204") == 0 ||
+                                            content.compare(9, 3, "304") == 0);
+    if (!bodyless &&
+        (lengthPos == std::string::npos || lengthPos > headerEnd) &&
+        (chunkedPos == std::string::npos || chunkedPos > headerEnd)) keepAlive = false;
+
+    // HEAD 的响应只发送到空行为止，主体留给调用者跳过
+    std::string_view view(content);
+    if (headOnly) view = view.substr(0, headerEnd + 4);
+
+    size_t connPos = content.find("\r\nConnection:");
+    if (connPos != std::string::npos && connPos < headerEnd) {
+        keepAlive = keepAlive && content.compare(connPos + 14, 11, " keep-alive") == 0;
+        chain.add(view);
+        return;
     }
 
-    return true;
+    static const std::string keepAliveHeader = "\r\nConnection: keep-alive";
+    static const std::string closeHeader = "\r\nConnection: close";
+    chain.add(view.substr(0, headerEnd));
+    chain.add(keepAlive ? keepAliveHeader : closeHeader);
+    chain.add(view.substr(headerEnd));
 }
 
-bool FlaskCpp::serveStaticFile(const RequestData& reqData, std::string& response) {
-    if (reqData.path.rfind("/static/", 0) == 0) {
-        std::string filename = reqData.path.substr(8); // Убираем /static/
-        std::filesystem::path filePath = std::filesystem::current_path() / "static" / filename;
-        if (std::filesystem::exists(filePath) && std::filesystem::is_regular_file(filePath)) {
-            std::string ext = filePath.extension().string();
-#ifdef ENABLE_PHP
-            if(ext == ".php"){
-                // 通过php-cgi支持PHP
-                std::string phpOutput = executePHP(reqData, filePath);
-                response = phpOutput;
-                return true;
-            }
-#endif
+bool FlaskCpp::sendResponse(int clientSocket, const std::string& content, bool keepAlive, bool headOnly) {
+    flaskcpp::ResponseChain chain;
+    appendResponse(content, keepAlive, chain, headOnly);
+    if (!chain.sendTo(clientSocket)) return false;
+    return keepAlive;
+}
 
-            std::string ct = "text/plain";
-            if (ext == ".html") ct = "text/html";
-            else if (ext == ".css") ct = "text/css";
-            else if (ext == ".js") ct = "application/javascript";
-            else if (ext == ".json") ct = "application/json";
-            else if (ext == ".png") ct = "image/png";
-            else if (ext == ".jpg" || ext == ".jpeg") ct = "image/jpeg";
-            else if (ext == ".gif") ct = "image/gif";
-
-            std::ifstream f(filePath, std::ios::binary);
-            if (!f) return false;
-            std::ostringstream oss;
-            oss << f.rdbuf();
-            std::string body = oss.str();
+bool FlaskCpp::sendResponse(int clientSocket, const std::string& header, const std::string& body, bool keepAlive,
+                            bool headOnly) {
+    // 响应头和主体通过一次 sendmsg 发送，不需要拼接
+    flaskcpp::ResponseChain chain;
+    appendResponse(header, keepAlive, chain, headOnly);
+    if (!headOnly) chain.add(body);
+    if (!chain.sendTo(clientSocket)) return false;
+    return keepAlive;
+}
 
-            std::ostringstream resp;
-            resp << "HTTP/1.1 200 OK\r\n"
-                 << "Content-Type: " << ct << "\r\n"
-                 << "Content-Length: " << body.size() << "\r\n"
-                 << "Connection: close\r\n\r\n"
-                 << body;
+bool FlaskCpp::sendStream(int clientSocket, const flaskcpp::Response& resp, bool chunked, bool keepAlive,
+                          bool headOnly) {
+    std::string header = resp.text;
+    if (!chunked) {
+        // HTTP/1.0 不支持 chunked，主体直接发送，以关闭连接表示结束
+        static const std::string chunkedHeader = "Transfer-Encoding: chunked\r\n";
+        size_t pos = header.find(chunkedHeader);
+        if (pos != std::string::npos) header.erase(pos, chunkedHeader.size());
+        keepAlive = false;
+    }
+    keepAlive = sendResponse(clientSocket, header, keepAlive, headOnly);
+    // HEAD 的响应没有主体，连结束块也不发送
+    if (headOnly) return keepAlive;
+    if (!resp.stream) {
+        static const char lastChunk[] = "0\r\n\r\n";
+        if (chunked && !sendAll(clientSocket, lastChunk, sizeof(lastChunk) - 1)) return false;
+        return keepAlive;
+    }
+
+    bool failed = false;
+    // 发送一个块：长度(十六进制)\r\n 数据 \r\n；HTTP/1.0 直接发送数据
+    auto sendChunk = [&](const char* data, size_t size) {
+        if (!chunked) return sendAll(clientSocket, data, size);
+        char sizeLine[24];
+        int sizeLen = snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", size);
+        iovec iov[3] = {
+            {sizeLine, (size_t)sizeLen},
+            {(void*)data, size},
+            {(void*)"\r\n", 2}
+        };
+        return sendAllv(clientSocket, iov, 3);
+    };
 
-            response = resp.str();
+    // 小块数据合并后再发送，减少系统调用和块头的开销
+    std::string pending;
+    auto flush = [&]() {
+        if (pending.empty() || failed) return;
+        failed = !sendChunk(pending.data(), pending.size());
+        pending.clear();
+    };
+    flaskcpp::StreamWriter write = [&](const char* data, size_t size) {
+        if (failed) return false;
+        if (size == 0) {
+            flush();
+            return !failed;
+        }
+        if (pending.size() + size <= flaskcpp::STREAM_BUFFER_SIZE) {
+            if (pending.capacity() < flaskcpp::STREAM_BUFFER_SIZE) pending.reserve(flaskcpp::STREAM_BUFFER_SIZE);
+            pending.append(data, size);
             return true;
         }
+        flush();
+        if (failed) return false;
+        // 大块数据不复制，直接发送
+        if (size >= flaskcpp::STREAM_BUFFER_SIZE) {
+            failed = !sendChunk(data, size);
+        } else {
+            pending.assign(data, size);
+        }
+        return !failed;
+    };
+
+    try {
+        resp.stream(write);
+    } catch (...) {
+        // 响应头已经发出，无法再返回500，只能断开连接让客户端看到不完整的响应
+        failed = true;
     }
-    return false;
-}
+    flush();
+    if (failed) return false;
 
-void FlaskCpp::sendResponse(int clientSocket, const std::string& content) {
-    send(clientSocket, content.c_str(), content.size(), MSG_NOSIGNAL);
+    if (chunked) {
+        static const char lastChunk[] = "0\r\n\r\n";
+        if (!sendAll(clientSocket, lastChunk, sizeof(lastChunk) - 1)) return false;
+    }
+    return keepAlive;
 }
 
 std::string FlaskCpp::generate404Error(const std::string& msg, bool gen_header) {
-    std::ostringstream response;
-    std::ostringstream body;
-    body << R"(
+    std::string body = R"(
 <!DOCTYPE html>
 <html lang="ru">
 <head>
@@ -1655,27 +1974,23 @@ std::string FlaskCpp::generate404Error(const std::string& msg, bool gen_header)
             </svg>
         </div>
         <h1>404</h1>
-        <p>)" << msg << R"(</p>
+        <p>)";
+    body += msg;
+    body += R"(</p>
         <a href="/">Back to Main Page</a>
     </div>
 </body>
 </html>
 )";
-    if (gen_header)
+    if (!gen_header)
     {
-        response << "HTTP/1.1 404 Not Found\r\n"
-                << "Content-Type: text/html; charset=UTF-8\r\n"
-                << "Content-Length: " << body.str().size() << "\r\n"
-                << "Connection: close\r\n\r\n";
+        return body;
     }
-    response << body.str();
-    return response.str();
+    return flaskcpp::ResponseWriter::build(404, "text/html; charset=UTF-8", body);
 }
 
 std::string FlaskCpp::generate500Error(const std::string& msg, bool gen_header) {
-    std::ostringstream response;
-    std::ostringstream body;
-    body << R"(
+    std::string body = R"(
 <!DOCTYPE html>
 <html lang="ru">
 <head>
@@ -1753,22 +2068,19 @@ std::string FlaskCpp::generate500Error(const std::string& msg, bool gen_header)
             </svg>
         </div>
         <h1>500</h1>
-        <p>)" << msg << R"(</p>
+        <p>)";
+    body += msg;
+    body += R"(</p>
         <a href="/">Back to Main page</a>
     </div>
 </body>
 </html>
 )";
-    if (gen_header)
+    if (!gen_header)
     {
-        response << "HTTP/1.1 500 Internal Server Error\r\n"
-                 << "Content-Type: text/html; charset=UTF-8\r\n"
-                 << "Content-Length: " << body.str().size() << "\r\n"
-                 << "Connection: close\r\n\r\n";
+        return body;
     }
-    response << body.str();
-    
-    return response.str();
+    return flaskcpp::ResponseWriter::build(500, "text/html; charset=UTF-8", body);
 }
 
 // 解析Cookie的实现
@@ -4,6 +4,12 @@
 #include <string>
 // #include <
 
+TempFile::~TempFile()
+{
+    if (fd >= 0) close(fd);
+    if (!path.empty()) unlink(path.c_str());
+}
+
 std::string stringLower(std::string src)
 {
     std::string ret = "";
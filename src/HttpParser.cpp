@@ -0,0 +1,309 @@
+#include "FlaskCpp/HttpParser.h"
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cstdint>
+#include <algorithm>
+
+bool strEqualsIgnoreCase(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+void HttpParser::reset()
+{
+    state_ = STATE_REQUEST_LINE;
+    data_ = nullptr;
+    pos_ = 0;
+    bodyStart_ = 0;
+    contentLength_ = 0;
+    bodyConsumed_ = 0;
+    chunked_ = false;
+    mustClose_ = false;
+    chunkState_ = CHUNK_SIZE;
+    chunkRemaining_ = 0;
+    method_ = target_ = version_ = Slice();
+    headers_.clear();
+}
+
+std::string_view HttpParser::path() const
+{
+    std::string_view t = target();
+    size_t q = t.find('?');
+    return q == std::string_view::npos ? t : t.substr(0, q);
+}
+
+std::string_view HttpParser::query() const
+{
+    std::string_view t = target();
+    size_t q = t.find('?');
+    return q == std::string_view::npos ? std::string_view() : t.substr(q + 1);
+}
+
+std::string_view HttpParser::header(std::string_view name) const
+{
+    for (const auto& h: headers_) {
+        if (strEqualsIgnoreCase(view(h.name), name)) return view(h.value);
+    }
+    return std::string_view();
+}
+
+bool HttpParser::hasHeader(std::string_view name) const
+{
+    for (const auto& h: headers_) {
+        if (strEqualsIgnoreCase(view(h.name), name)) return true;
+    }
+    return false;
+}
+
+HttpParser::State HttpParser::parse(std::string& buffer)
+{
+    const char* data = buffer.data();
+    size_t size = buffer.size();
+    data_ = data;
+
+    while (state_ == STATE_REQUEST_LINE || state_ == STATE_HEADERS) {
+        const char* nl = (const char*)memchr(data + pos_, '\n', size - pos_);
+        if (!nl) {
+            if (size > MAX_HEADER_SIZE) state_ = STATE_ERROR;
+            return state_;
+        }
+        size_t lineEnd = nl - data;
+        size_t next = lineEnd + 1;
+        if (lineEnd > pos_ && data[lineEnd - 1] == '\r') --lineEnd;
+
+        if (state_ == STATE_REQUEST_LINE) {
+            // 忽略请求行之前的空行
+            if (lineEnd == pos_) {
+                pos_ = next;
+                continue;
+            }
+            if (!parseRequestLine(lineEnd)) {
+                state_ = STATE_ERROR;
+                return state_;
+            }
+            state_ = STATE_HEADERS;
+        }
+        else if (lineEnd == pos_) {
+            // 空行，头部结束
+            bodyStart_ = next;
+            if (!onHeadersComplete()) {
+                state_ = STATE_ERROR;
+                return state_;
+            }
+            state_ = STATE_BODY;
+        }
+        else if (!parseHeaderLine(lineEnd)) {
+            state_ = STATE_ERROR;
+            return state_;
+        }
+        pos_ = next;
+        if (pos_ > MAX_HEADER_SIZE) {
+            state_ = STATE_ERROR;
+            return state_;
+        }
+    }
+
+    if (state_ == STATE_BODY && chunked_) {
+        return parseChunked(buffer);
+    }
+    if (state_ == STATE_BODY && size - bodyStart_ >= bodyRemaining()) {
+        state_ = STATE_COMPLETE;
+    }
+    return state_;
+}
+
+HttpParser::State HttpParser::parseChunked(std::string& buffer)
+{
+    // 已解码的主体位于 [bodyStart_, out)，in 之后是尚未解码的原始数据。
+    // 块数据向前移动到 out，块头和 CRLF 被跳过，最后一次性删除 [out, in)，
+    // 所以每个字节只移动一次，大量小块也是线性时间
+    size_t out = bodyStart_ + bodyRemaining();
+    size_t in = out;
+    size_t size = buffer.size();
+    char* data = &buffer[0];
+    while (state_ == STATE_BODY) {
+        if (chunkState_ == CHUNK_DATA) {
+            size_t n = std::min(size - in, chunkRemaining_);
+            if (out != in) memmove(data + out, data + in, n);
+            out += n;
+            in += n;
+            contentLength_ += n;
+            chunkRemaining_ -= n;
+            if (chunkRemaining_ > 0) break;
+            chunkState_ = CHUNK_DATA_END;
+            continue;
+        }
+        if (chunkState_ == CHUNK_DATA_END) {
+            // 块数据之后的 CRLF（也接受单独的 LF）
+            if (in >= size) break;
+            size_t n = 0;
+            if (data[in] == '\n') n = 1;
+            else if (data[in] == '\r') {
+                if (in + 1 >= size) break;
+                if (data[in + 1] == '\n') n = 2;
+            }
+            if (!n) {
+                state_ = STATE_ERROR;
+                break;
+            }
+            in += n;
+            chunkState_ = CHUNK_SIZE;
+            continue;
+        }
+
+        // 块头或 trailer 的一行
+        const char* nlp = (const char*)memchr(data + in, '\n', size - in);
+        if (!nlp) {
+            if (size - in > MAX_CHUNK_LINE) state_ = STATE_ERROR;
+            break;
+        }
+        size_t nl = nlp - data;
+        if (nl - in > MAX_CHUNK_LINE) {
+            state_ = STATE_ERROR;
+            break;
+        }
+        size_t lineEnd = (nl > in && data[nl - 1] == '\r') ? nl - 1 : nl;
+
+        if (chunkState_ == CHUNK_TRAILER) {
+            // trailer 字段忽略，空行表示请求结束
+            bool last = lineEnd == in;
+            in = nl + 1;
+            if (last) state_ = STATE_COMPLETE;
+            continue;
+        }
+
+        // 十六进制长度，后面可以有 ;extension
+        size_t chunkSize = 0, digits = 0, i = in;
+        for (; i < lineEnd; ++i, ++digits) {
+            char c = data[i];
+            int v = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                    (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if (v < 0) break;
+            if (chunkSize > (SIZE_MAX >> 4)) {
+                state_ = STATE_ERROR;
+                break;
+            }
+            chunkSize = (chunkSize << 4) | v;
+        }
+        if (state_ == STATE_ERROR) break;
+        while (i < lineEnd && (data[i] == ' ' || data[i] == '\t')) ++i;
+        if (!digits || (i < lineEnd && data[i] != ';')) {
+            state_ = STATE_ERROR;
+            break;
+        }
+        in = nl + 1;
+        if (chunkSize == 0) {
+            chunkState_ = CHUNK_TRAILER;
+        }
+        else {
+            chunkRemaining_ = chunkSize;
+            chunkState_ = CHUNK_DATA;
+        }
+    }
+    if (in > out) buffer.erase(out, in - out);
+    data_ = buffer.data();
+    return state_;
+}
+
+bool HttpParser::parseRequestLine(size_t lineEnd)
+{
+    // METHOD SP request-target SP HTTP-version
+    size_t sp1 = pos_;
+    while (sp1 < lineEnd && data_[sp1] != ' ') ++sp1;
+    if (sp1 == pos_ || sp1 >= lineEnd) return false;
+
+    size_t start = sp1 + 1;
+    size_t sp2 = start;
+    while (sp2 < lineEnd && data_[sp2] != ' ') ++sp2;
+    if (sp2 == start) return false;
+
+    method_ = {pos_, sp1 - pos_};
+    target_ = {start, sp2 - start};
+    if (sp2 < lineEnd) {
+        version_ = {sp2 + 1, lineEnd - sp2 - 1};
+    }
+    else {
+        version_ = {lineEnd, 0};   // HTTP/0.9 风格，没有版本号
+    }
+    return true;
+}
+
+bool HttpParser::parseHeaderLine(size_t lineEnd)
+{
+    const char* colon = (const char*)memchr(data_ + pos_, ':', lineEnd - pos_);
+    if (!colon) return true;   // 忽略格式错误的头
+
+    size_t nameEnd = colon - data_;
+    size_t valueStart = nameEnd + 1;
+    while (valueStart < lineEnd && (data_[valueStart] == ' ' || data_[valueStart] == '\t')) ++valueStart;
+    size_t valueEnd = lineEnd;
+    while (valueEnd > valueStart && (data_[valueEnd - 1] == ' ' || data_[valueEnd - 1] == '\t')) --valueEnd;
+
+    headers_.push_back({{pos_, nameEnd - pos_}, {valueStart, valueEnd - valueStart}});
+    return true;
+}
+
+bool HttpParser::onHeadersComplete()
+{
+    // Transfer-Encoding 优先于 Content-Length，所有 Transfer-Encoding 头中最后一个编码必须是 chunked
+    std::string_view last;
+    bool hasEncoding = false, hasLength = false;
+    for (const auto& h: headers_) {
+        std::string_view name = view(h.name);
+        if (strEqualsIgnoreCase(name, "Content-Length")) {
+            hasLength = true;
+        }
+        else if (strEqualsIgnoreCase(name, "Transfer-Encoding")) {
+            std::string_view encoding = view(h.value);
+            size_t comma = encoding.rfind(',');
+            last = comma == std::string_view::npos ? encoding : encoding.substr(comma + 1);
+            while (!last.empty() && (last.front() == ' ' || last.front() == '\t')) last.remove_prefix(1);
+            hasEncoding = true;
+        }
+    }
+    if (hasEncoding) {
+        // HTTP/1.0 没有 Transfer-Encoding，中间的代理可能按其他方式确定边界（RFC 9112 6.1）
+        if (version() == "HTTP/1.0") return false;
+        if (!strEqualsIgnoreCase(last, "chunked")) return false;
+        chunked_ = true;
+        // 同时带有 Content-Length 时忽略它，但响应之后必须关闭连接（RFC 9112 6.1）
+        mustClose_ = hasLength;
+        return true;
+    }
+
+    // 所有 Content-Length 头（包括逗号分隔的列表）必须是同一个值，否则无法确定请求的边界，
+    // 与前端代理的理解不一致时会导致请求走私（RFC 9112 6.3）
+    hasLength = false;
+    for (const auto& h: headers_) {
+        if (!strEqualsIgnoreCase(view(h.name), "Content-Length")) continue;
+        std::string_view list = view(h.value);
+        while (true) {
+            size_t comma = list.find(',');
+            std::string_view item = list.substr(0, comma);
+            while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+            while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+
+            // 非数字或超出 size_t 范围时拒绝请求，不能回绕成一个较小的长度
+            if (item.empty()) return false;
+            size_t value = 0;
+            for (char c: item) {
+                if (c < '0' || c > '9') return false;
+                size_t digit = c - '0';
+                if (value > (SIZE_MAX - digit) / 10) return false;
+                value = value * 10 + digit;
+            }
+            if (hasLength && value != contentLength_) return false;
+            hasLength = true;
+            contentLength_ = value;
+
+            if (comma == std::string_view::npos) break;
+            list.remove_prefix(comma + 1);
+        }
+    }
+    return true;
+}
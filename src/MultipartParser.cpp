@@ -0,0 +1,243 @@
+#include "FlaskCpp/MultipartParser.h"
+#include "FlaskCpp/HttpParser.h"
+#include <filesystem>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstdlib>
+
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+static std::string_view unquote(std::string_view s)
+{
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"') {
+        s.remove_prefix(1);
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+MultipartParser::MultipartParser(std::string boundary, std::string uploadDir, UploadSink sink)
+:delimiter_("\r\n--" + boundary), uploadDir_(std::move(uploadDir)), sink_(std::move(sink))
+{
+    // 第一个分隔符前面没有CRLF，补上后所有分隔符可以统一处理
+    pending_ = "\r\n";
+}
+
+std::string MultipartParser::boundaryOf(std::string_view contentType)
+{
+    static const std::string_view type = "multipart/form-data";
+    if (contentType.size() < type.size() || !strEqualsIgnoreCase(contentType.substr(0, type.size()), type)) {
+        return "";
+    }
+    size_t pos = contentType.find("boundary=");
+    if (pos == std::string_view::npos) return "";
+    std::string_view value = contentType.substr(pos + 9);
+    value = unquote(trim(value.substr(0, value.find(';'))));
+    return std::string(value);
+}
+
+bool MultipartParser::write(const char* data, size_t size)
+{
+    if (state_ == STATE_ERROR) return false;
+    if (state_ == STATE_DONE) return true;
+    pending_.append(data, size);
+
+    while (true) {
+        switch (state_) {
+        case STATE_PREAMBLE: {
+            size_t pos = pending_.find(delimiter_);
+            if (pos == std::string::npos) {
+                // 只保留可能是分隔符开头的部分
+                size_t keep = delimiter_.size() - 1;
+                if (pending_.size() > keep) pending_.erase(0, pending_.size() - keep);
+                return true;
+            }
+            pending_.erase(0, pos + delimiter_.size());
+            state_ = STATE_DELIMITER;
+            break;
+        }
+        case STATE_DELIMITER:
+            if (pending_.size() < 2) return true;
+            if (pending_.compare(0, 2, "--") == 0) {
+                state_ = STATE_DONE;
+                pending_.clear();
+                return true;
+            }
+            if (pending_.compare(0, 2, "\r\n") != 0) {
+                state_ = STATE_ERROR;
+                return false;
+            }
+            pending_.erase(0, 2);
+            state_ = STATE_HEADERS;
+            break;
+        case STATE_HEADERS: {
+            size_t headerEnd, consumed;
+            if (pending_.compare(0, 2, "\r\n") == 0) {
+                headerEnd = 0;      // 没有部分头
+                consumed = 2;
+            }
+            else {
+                headerEnd = pending_.find("\r\n\r\n");
+                if (headerEnd == std::string::npos) {
+                    if (pending_.size() > MAX_PART_HEADER_SIZE) {
+                        state_ = STATE_ERROR;
+                        return false;
+                    }
+                    return true;
+                }
+                consumed = headerEnd + 4;
+            }
+            if (!parsePartHeaders(std::string_view(pending_.data(), headerEnd)) || !beginPart()) {
+                state_ = STATE_ERROR;
+                return false;
+            }
+            pending_.erase(0, consumed);
+            state_ = STATE_DATA;
+            break;
+        }
+        case STATE_DATA: {
+            size_t pos = pending_.find(delimiter_);
+            if (pos == std::string::npos) {
+                // 末尾可能是分隔符的一部分，留到下一次
+                size_t keep = delimiter_.size() - 1;
+                if (pending_.size() > keep) {
+                    size_t n = pending_.size() - keep;
+                    if (!appendPart(pending_.data(), n)) {
+                        state_ = STATE_ERROR;
+                        return false;
+                    }
+                    pending_.erase(0, n);
+                }
+                return true;
+            }
+            if (!appendPart(pending_.data(), pos) || !endPart()) {
+                state_ = STATE_ERROR;
+                return false;
+            }
+            pending_.erase(0, pos + delimiter_.size());
+            state_ = STATE_DELIMITER;
+            break;
+        }
+        case STATE_DONE:
+            return true;
+        case STATE_ERROR:
+            return false;
+        }
+    }
+}
+
+bool MultipartParser::parsePartHeaders(std::string_view headers)
+{
+    part_ = RequestData::File();
+    value_.clear();
+    isFile_ = false;
+    bool hasFileName = false;
+
+    while (!headers.empty()) {
+        size_t lineEnd = headers.find("\r\n");
+        std::string_view line = headers.substr(0, lineEnd);
+        headers.remove_prefix(lineEnd == std::string_view::npos ? headers.size() : lineEnd + 2);
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) continue;
+        std::string_view name = trim(line.substr(0, colon));
+        std::string_view value = trim(line.substr(colon + 1));
+
+        if (strEqualsIgnoreCase(name, "Content-Type")) {
+            part_.type = std::string(value);
+        }
+        else if (strEqualsIgnoreCase(name, "Content-Disposition")) {
+            // form-data; name="x"; filename="a.txt"
+            while (!value.empty()) {
+                size_t semi = value.find(';');
+                std::string_view param = trim(value.substr(0, semi));
+                value.remove_prefix(semi == std::string_view::npos ? value.size() : semi + 1);
+
+                size_t eq = param.find('=');
+                if (eq == std::string_view::npos) continue;
+                std::string_view key = trim(param.substr(0, eq));
+                std::string_view val = unquote(trim(param.substr(eq + 1)));
+                if (strEqualsIgnoreCase(key, "name")) {
+                    part_.name = std::string(val);
+                }
+                else if (strEqualsIgnoreCase(key, "filename")) {
+                    part_.file_name = std::string(val);
+                    hasFileName = true;
+                }
+            }
+        }
+    }
+
+    // 浏览器在没有选择文件时发送空的 filename，按普通字段处理
+    isFile_ = hasFileName && !part_.file_name.empty();
+    return true;
+}
+
+bool MultipartParser::beginPart()
+{
+    if (!isFile_ || sink_) return true;
+
+    std::string dir = uploadDir_.empty() ? std::filesystem::temp_directory_path().string() : uploadDir_;
+    std::string name = dir + "/flaskcpp-upload-XXXXXX";
+    std::vector<char> tmpl(name.begin(), name.end());
+    tmpl.push_back('\0');
+    int fd = mkostemp(tmpl.data(), O_CLOEXEC);
+    if (fd < 0) return false;
+
+    part_.temp = std::make_shared<TempFile>();
+    part_.temp->path = tmpl.data();
+    part_.temp->fd = fd;
+    part_.path = part_.temp->path;
+    part_.fd = fd;
+    return true;
+}
+
+bool MultipartParser::appendPart(const char* data, size_t size)
+{
+    if (!size) return true;
+    if (!isFile_) {
+        if (value_.size() + size > MAX_FIELD_SIZE) return false;
+        value_.append(data, size);
+        return true;
+    }
+
+    part_.size += size;
+    if (sink_) return sink_(part_, data, size);
+
+    while (size > 0) {
+        ssize_t n = ::write(part_.fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool MultipartParser::endPart()
+{
+    if (!isFile_) {
+        fields_[part_.name] = std::move(value_);
+        value_.clear();
+        return true;
+    }
+
+    if (sink_) {
+        if (!sink_(part_, nullptr, 0)) return false;
+    }
+    else {
+        lseek(part_.fd, 0, SEEK_SET);
+    }
+    std::string key = part_.file_name;
+    files_[key] = std::move(part_);
+    part_ = RequestData::File();
+    return true;
+}
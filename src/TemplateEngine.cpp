@@ -2,26 +2,271 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
-#include <regex>
 #include <filesystem>
 
 // Реализация методов класса TemplateEngine
 
+// Максимальная глубина цепочки extends (защита от циклов)
+static const size_t MAX_EXTENDS_DEPTH = 16;
+
+static bool isHidden(const std::string& name)
+{
+    return name.size() >= 2 && name[0] == '_' && name[1] == '_';
+}
+
+static std::string trim(const std::string& s)
+{
+    size_t begin = 0, end = s.size();
+    while (begin < end && std::isspace((unsigned char)s[begin])) ++begin;
+    while (end > begin && std::isspace((unsigned char)s[end - 1])) --end;
+    return s.substr(begin, end - begin);
+}
+
+static std::vector<std::string> splitWords(const std::string& s)
+{
+    std::vector<std::string> words;
+    std::istringstream in(s);
+    std::string word;
+    while (in >> word) words.push_back(word);
+    return words;
+}
+
+// Имя в кавычках: "header.html"
+static bool parseQuoted(const std::string& s, std::string& name)
+{
+    std::string t = trim(s);
+    if (t.size() < 3 || t.front() != '"' || t.back() != '"') return false;
+    name = t.substr(1, t.size() - 2);
+    return name.find('"') == std::string::npos;
+}
+
+namespace {
+
+// Однопроходный разбор шаблона: {{ var | filter }}, {# комментарий #} и теги
+// {% if %}/{% else %}/{% endif %}, {% for x in list %}/{% endfor %}, {% include "name" %},
+// {% extends "name" %}, {% block name %}/{% endblock %}.
+// Нераспознанные и непарные конструкции остаются текстом.
+class TemplateParser {
+public:
+    using Node = TemplateEngine::Node;
+
+    TemplateParser(const std::string& src, std::string& extends) : src(src), extends(extends) {}
+
+    // Разбирает узлы до одного из закрывающих тегов; возвращает найденный тег или "" в конце текста
+    std::string parse(std::vector<Node>& out, std::initializer_list<const char*> ends)
+    {
+        while (pos < src.size()) {
+            size_t open = src.find('{', pos);
+            while (open != std::string::npos && open + 1 < src.size() &&
+                   src[open + 1] != '{' && src[open + 1] != '%' && src[open + 1] != '#') {
+                open = src.find('{', open + 1);
+            }
+            if (open == std::string::npos || open + 1 >= src.size()) {
+                appendText(out, src.size());
+                break;
+            }
+            appendText(out, open);
+
+            char kind = src[open + 1];
+            const char* closeSeq = kind == '{' ? "}}" : kind == '%' ? "%}" : "#}";
+            size_t close = src.find(closeSeq, open + 2);
+            if (close == std::string::npos) {
+                appendText(out, src.size());
+                break;
+            }
+            std::string inner = src.substr(open + 2, close - (open + 2));
+            pos = close + 2;
+
+            if (kind == '#') continue;
+            if (kind == '{') {
+                out.push_back(variable(inner));
+                continue;
+            }
+
+            std::string tag = trim(inner);
+            std::vector<std::string> words = splitWords(tag);
+            const std::string& keyword = words.empty() ? tag : words[0];
+            for (const char* end: ends) {
+                if (keyword == end) return keyword;
+            }
+
+            Node node;
+            if (keyword == "if" && words.size() == 2) {
+                node.type = Node::IF;
+                node.text = words[1];
+                if (parse(node.children, {"else", "endif"}) == "else") {
+                    parse(node.elseChildren, {"endif"});
+                }
+            }
+            else if (keyword == "for" && words.size() == 4 && words[2] == "in") {
+                node.type = Node::FOR;
+                node.loopVar = words[1];
+                node.text = words[3];
+                parse(node.children, {"endfor"});
+            }
+            else if (keyword == "block" && words.size() == 2) {
+                node.type = Node::BLOCK;
+                node.text = words[1];
+                parse(node.children, {"endblock"});
+            }
+            else if (keyword == "include" && parseQuoted(tag.substr(7), node.text)) {
+                node.type = Node::INCLUDE;
+            }
+            else if (keyword == "extends" && parseQuoted(tag.substr(7), extends)) {
+                continue;
+            }
+            else {
+                // Неизвестный тег выводится как есть
+                node.text = src.substr(open, pos - open);
+            }
+            out.push_back(std::move(node));
+        }
+        return "";
+    }
+
+private:
+    const std::string& src;
+    std::string& extends;
+    size_t pos = 0;
+
+    void appendText(std::vector<Node>& out, size_t end)
+    {
+        if (end <= pos) return;
+        if (out.empty() || out.back().type != Node::TEXT) out.emplace_back();
+        out.back().text.append(src, pos, end - pos);
+        pos = end;
+    }
+
+    static Node variable(const std::string& expr)
+    {
+        Node node;
+        node.type = Node::VAR;
+        size_t pipePos = expr.find('|');
+        node.text = trim(expr.substr(0, pipePos));
+        if (pipePos != std::string::npos) {
+            std::string filter = trim(expr.substr(pipePos + 1));
+            if (filter == "upper") node.filter = Node::UPPER;
+            else if (filter == "lower") node.filter = Node::LOWER;
+            else if (filter == "escape") node.filter = Node::ESCAPE;
+        }
+        return node;
+    }
+};
+
+// Блоки, переменные и включения шаблона
+void collectInfo(const std::vector<TemplateEngine::Node>& nodes, TemplateEngine::Program& program)
+{
+    using Node = TemplateEngine::Node;
+    for (const auto& node: nodes) {
+        switch (node.type) {
+        case Node::VAR:
+        case Node::IF:
+        case Node::FOR:
+            program.variables.push_back(node.text);
+            break;
+        case Node::INCLUDE:
+            program.includes.push_back(node.text);
+            break;
+        case Node::BLOCK:
+            program.blocks.emplace(node.text, &node);
+            break;
+        default:
+            break;
+        }
+        collectInfo(node.children, program);
+        collectInfo(node.elseChildren, program);
+    }
+}
+
+void uniqueSort(std::vector<std::string>& v)
+{
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+}
+
+} // namespace
+
+std::shared_ptr<TemplateEngine::Program> TemplateEngine::compile(const std::string& content)
+{
+    auto program = std::make_shared<Program>();
+    program->source = content;
+    TemplateParser parser(program->source, program->extends);
+    parser.parse(program->nodes, {});
+    collectInfo(program->nodes, *program);
+    uniqueSort(program->variables);
+    uniqueSort(program->includes);
+    return program;
+}
+
+// Реестр сгенерированных функций рендера
+struct CompiledEntry {
+    std::string source;
+    TemplateEngine::CompiledRender render;
+};
+
+static std::mutex& compiledMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::map<std::string, CompiledEntry>& compiledRegistry()
+{
+    static std::map<std::string, CompiledEntry> registry;
+    return registry;
+}
+
+bool TemplateEngine::registerCompiled(const char* name, const char* source, size_t size, CompiledRender render)
+{
+    std::lock_guard<std::mutex> lock(compiledMutex());
+    compiledRegistry()[name] = CompiledEntry{std::string(source, size), render};
+    return true;
+}
+
+TemplateEngine::TemplateEngine()
+{
+    std::vector<std::pair<std::string, std::string>> compiled;
+    {
+        std::lock_guard<std::mutex> lock(compiledMutex());
+        for (const auto& [name, entry] : compiledRegistry()) {
+            compiled.emplace_back(name, entry.source);
+        }
+    }
+    for (const auto& [name, source] : compiled) {
+        setTemplate(name, source);
+    }
+}
+
 void TemplateEngine::setTemplate(const std::string& name, const std::string& content) {
-    templates[name] = content;
+    // Новое поколение делает недействительными закэшированные включения,
+    // зависящие от этого шаблона; старые записи вытеснит LRU
+    std::shared_ptr<Program> program = compile(content);
+    program->generation = nextGeneration.fetch_add(1);
+    {
+        // Сгенерированная функция подходит, только если текст шаблона не изменился
+        std::lock_guard<std::mutex> lock(compiledMutex());
+        auto it = compiledRegistry().find(name);
+        if (it != compiledRegistry().end() && it->second.source == content) {
+            program->compiled = it->second.render;
+        }
+    }
+    std::lock_guard<std::mutex> lock(templateMutex);
+    templates[name] = std::move(program);
 }
 
-std::string TemplateEngine::getTemplateContent(const std::string& name) const {
+std::shared_ptr<const TemplateEngine::Program> TemplateEngine::findTemplate(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(templateMutex);
     auto it = templates.find(name);
     if (it != templates.end()) return it->second;
-    return "";
+    return nullptr;
 }
 
 std::vector<std::string> TemplateEngine::getAllTemplateNames()
 {
+    std::lock_guard<std::mutex> lock(templateMutex);
     std::vector<std::string> names;
     names.reserve(templates.size());
-    for (auto t: templates)
+    for (const auto& t: templates)
     {
         names.push_back(t.first);
     }
@@ -62,73 +307,137 @@ void TemplateEngine::checkConfigOnce()
 
 
 std::string TemplateEngine::render(const std::string& templateName, const Context& context) const {
-    std::string tpl = getTemplateContent(templateName);
-    if (tpl.empty()) {
+    std::shared_ptr<const Program> program = findTemplate(templateName);
+    if (!program || program->source.empty()) {
         return "";
     }
-    return renderTemplateContent(tpl, context);
+    Output output;
+    output.buffer.reserve(program->source.size());
+    Scope scope;
+    scope.context = &context;
+    renderProgram(program, scope, output);
+    return std::move(output.buffer);
 }
 
-// Хэширование контекста
-size_t TemplateEngine::hashContext(const Context& context) const {
-    size_t seed = 0;
-    for (const auto& [key, value] : context) {
-        seed ^= std::hash<std::string>()(key) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-        if (std::holds_alternative<std::string>(value)) {
-            seed ^= std::hash<std::string>()(std::get<std::string>(value)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-        } else if (std::holds_alternative<bool>(value)) {
-            seed ^= std::hash<bool>()(std::get<bool>(value)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-        } else if (std::holds_alternative<std::vector<std::map<std::string, std::string>>>(value)) {
-            const auto& vec = std::get<std::vector<std::map<std::string, std::string>>>(value);
-            for (const auto& mapItem : vec) {
-                for (const auto& [k, v] : mapItem) {
-                    seed ^= std::hash<std::string>()(k) ^ std::hash<std::string>()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-                }
-            }
-        }
+bool TemplateEngine::render(const std::string& templateName, const Context& context,
+                            const OutputSink& sink, size_t chunkSize) const {
+    std::shared_ptr<const Program> program = findTemplate(templateName);
+    if (!program || program->source.empty()) {
+        return false;
     }
-    return seed;
+    Output output;
+    output.sink = &sink;
+    output.chunkSize = std::max<size_t>(chunkSize, 1);
+    output.buffer.reserve(output.chunkSize + 1024);
+    Scope scope;
+    scope.context = &context;
+    renderProgram(program, scope, output);
+    output.flush();
+    return !output.failed;
 }
 
-std::string TemplateEngine::renderTemplateContent(const std::string& content, const Context& context) const {
-    std::string result = content;
+bool TemplateEngine::hasTemplate(const std::string& templateName) const {
+    std::shared_ptr<const Program> program = findTemplate(templateName);
+    return program && !program->source.empty();
+}
 
-    // Обработка extends
-    std::map<std::string, std::string> childBlocks;
-    result = processExtends(result, context, childBlocks);
+static inline void hashCombine(size_t& seed, size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
 
-    // Обработка комментариев
-    result = processComments(result);
+static void hashValue(size_t& seed, const TemplateEngine::ValueType& value)
+{
+    if (std::holds_alternative<std::string>(value)) {
+        hashCombine(seed, std::hash<std::string>()(std::get<std::string>(value)));
+    } else if (std::holds_alternative<bool>(value)) {
+        hashCombine(seed, std::hash<bool>()(std::get<bool>(value)));
+    } else if (std::holds_alternative<JsonList>(value)) {
+        const auto& vec = std::get<JsonList>(value);
+        hashCombine(seed, vec.size());
+        for (const auto& mapItem : vec) {
+            for (const auto& [k, v] : mapItem) {
+                hashCombine(seed, std::hash<std::string>()(k) ^ std::hash<std::string>()(v));
+            }
+        }
+    }
+}
 
-    // include
-    result = processInclude(result, context);
+void TemplateEngine::hashDependencies(const Program& program, const Scope& scope, size_t& seed, size_t depth) const {
+    hashCombine(seed, program.generation);
+    if (depth > MAX_EXTENDS_DEPTH) return;
+
+    for (const std::string& name : program.variables) {
+        ValueRef ref = lookup(name, scope);
+        // item.field без переменной цикла читает первый элемент списка item
+        size_t dotPos = name.find('.');
+        if (!ref && dotPos != std::string::npos) ref = lookup(name.substr(0, dotPos), scope);
+        if (ref.field) hashCombine(seed, std::hash<std::string>()(*ref.field));
+        else if (ref.value) hashValue(seed, *ref.value);
+        else hashCombine(seed, 0);
+    }
 
-    // if
-    {
-        size_t pos = 0;
-        while (true) {
-            size_t ifPos = result.find("{% if ", pos);
-            if (ifPos == std::string::npos) break;
-            result = processIf(result, context);
-            pos = 0;
+    auto hashTemplate = [&](const std::string& name) {
+        std::shared_ptr<const Program> dep = findTemplate(name);
+        if (dep) hashDependencies(*dep, scope, seed, depth + 1);
+        else hashCombine(seed, 0);
+    };
+    for (const std::string& name : program.includes) hashTemplate(name);
+    if (!program.extends.empty()) hashTemplate(program.extends);
+}
+
+void TemplateEngine::renderProgram(const std::shared_ptr<const Program>& program, const Scope& scope, Output& output) const {
+    // Поднимаемся по цепочке extends; блок из самого дочернего шаблона имеет приоритет
+    BlockMap blocks;
+    std::vector<std::shared_ptr<const Program>> chain{program};
+    while (!chain.back()->extends.empty() && chain.size() <= MAX_EXTENDS_DEPTH) {
+        const Program& child = *chain.back();
+        for (const auto& [name, node] : child.blocks) {
+            blocks.emplace(name, node);
         }
+        std::shared_ptr<const Program> base = findTemplate(child.extends);
+        if (!base) {
+            output.buffer += "Base template not found: " + child.extends;
+            return;
+        }
+        chain.push_back(std::move(base));
+    }
+    const Program& root = *chain.back();
+    if (root.compiled) {
+        RenderContext ctx(*this, scope, blocks, output);
+        root.compiled(ctx);
+    } else {
+        renderNodes(root.nodes, scope, blocks, output);
     }
+}
 
-    // for
-    {
-        size_t pos = 0;
-        while (true) {
-            size_t forPos = result.find("{% for ", pos);
-            if (forPos == std::string::npos) break;
-            result = processFor(result, context);
-            pos = 0;
+void TemplateEngine::renderNodes(const std::vector<Node>& nodes, const Scope& scope, const BlockMap& blocks, Output& output) const {
+    for (const Node& node : nodes) {
+        if (output.failed) return;
+        switch (node.type) {
+        case Node::TEXT:
+            output.buffer += node.text;
+            break;
+        case Node::VAR:
+            renderVariable(node.text, node.filter, scope, output.buffer);
+            break;
+        case Node::IF:
+            renderNodes(evaluateCondition(node.text, scope) ? node.children : node.elseChildren, scope, blocks, output);
+            break;
+        case Node::FOR:
+            renderLoop(node, scope, blocks, output);
+            break;
+        case Node::INCLUDE:
+            renderInclude(node.text, scope, output.buffer);
+            break;
+        case Node::BLOCK: {
+            auto it = blocks.find(node.text);
+            renderNodes(it != blocks.end() ? it->second->children : node.children, scope, blocks, output);
+            break;
+        }
         }
+        if (output.sink && output.buffer.size() >= output.chunkSize) output.flush();
     }
-
-    // variables
-    result = replaceVariables(result, context);
-
-    return result;
 }
 
 void TemplateEngine::execAllCheckTask()
@@ -139,385 +448,216 @@ void TemplateEngine::execAllCheckTask()
     }
 }
 
-bool TemplateEngine::evaluateCondition(const std::string& varName, const Context& context) const {
-    if (varName[0] == '_' && varName[1] == '_') return false;
-    auto it = context.find(varName);
-    if (it == context.end()) return false;
-    if (std::holds_alternative<bool>(it->second)) {
-        return std::get<bool>(it->second);
-    } else if (std::holds_alternative<std::string>(it->second)) {
-        return !std::get<std::string>(it->second).empty();
-    } else if (std::holds_alternative<std::vector<std::map<std::string, std::string>>>(it->second)) {
-        return !std::get<std::vector<std::map<std::string, std::string>>>(it->second).empty();
+TemplateEngine::ValueRef TemplateEngine::lookup(const std::string& varName, const Scope& scope) const {
+    ValueRef ref;
+    if (isHidden(varName)) return ref;
+    const Scope* frame = &scope;
+    for (; frame->parent; frame = frame->parent) {
+        // loopVar.field из текущего элемента цикла
+        const std::string& loopVar = *frame->loopVar;
+        if (varName.size() > loopVar.size() + 1 && varName[loopVar.size()] == '.' &&
+            varName.compare(0, loopVar.size(), loopVar) == 0) {
+            auto it = frame->item->find(varName.substr(loopVar.size() + 1));
+            if (it != frame->item->end()) {
+                ref.field = &it->second;
+                return ref;
+            }
+        }
     }
-    return false;
+    auto it = frame->context->find(varName);
+    if (it != frame->context->end()) ref.value = &it->second;
+    return ref;
 }
 
-std::string TemplateEngine::replaceVariables(const std::string& str, const Context& context) const {
-    std::string result = str;
-    size_t startPos = 0;
-    while (true) {
-        size_t start = result.find("{{", startPos);
-        if (start == std::string::npos) break;
-        size_t end = result.find("}}", start);
-        if (end == std::string::npos) break;
-
-        std::string varExpr = trim(result.substr(start + 2, end - (start + 2)));
-        size_t pipePos = varExpr.find('|');
-        std::string varName = varExpr;
-        std::string filter;
-        if (pipePos != std::string::npos) {
-            varName = trim(varExpr.substr(0, pipePos));
-            filter = trim(varExpr.substr(pipePos + 1));
-        }
+bool TemplateEngine::evaluateCondition(const std::string& varName, const Scope& scope) const {
+    ValueRef ref = lookup(varName, scope);
+    if (ref.field) return !ref.field->empty();
+    if (!ref.value) return false;
+    const ValueType& value = *ref.value;
+    if (std::holds_alternative<bool>(value)) {
+        return std::get<bool>(value);
+    } else if (std::holds_alternative<std::string>(value)) {
+        return !std::get<std::string>(value).empty();
+    } else if (std::holds_alternative<JsonList>(value)) {
+        return !std::get<JsonList>(value).empty();
+    }
+    return false;
+}
 
-        std::string replacement;
-        auto it = context.find(varName);
-        if (it == context.end() || (varName[0] == '_' && varName[1] == '_')) {
-            // Попытка обработать вложенные переменные, например item.field
-            size_t dotPos = varName.find('.');
-            if (dotPos != std::string::npos) {
-                std::string parent = varName.substr(0, dotPos);
-                std::string child = varName.substr(dotPos + 1);
-                auto parentIt = context.find(parent);
-                if (parentIt != context.end() && std::holds_alternative<std::vector<std::map<std::string, std::string>>>(parentIt->second)) {
-                    // В данном упрощённом варианте берем первый элемент
-                    const auto& vec = std::get<std::vector<std::map<std::string, std::string>>>(parentIt->second);
-                    if (!vec.empty()) {
-                        auto childIt = vec[0].find(child);
-                        if (childIt != vec[0].end()) {
-                            replacement = childIt->second;
-                        }
-                    }
+void TemplateEngine::renderVariable(const std::string& varName, Node::Filter filter, const Scope& scope, std::string& output) const {
+    ValueRef ref = lookup(varName, scope);
+    if (ref.field) {
+        applyFilter(*ref.field, filter, output);
+        return;
+    }
+    if (!ref.value) {
+        // Попытка обработать вложенные переменные, например item.field
+        size_t dotPos = varName.find('.');
+        if (dotPos == std::string::npos) return;
+        ValueRef parent = lookup(varName.substr(0, dotPos), scope);
+        if (parent.value && std::holds_alternative<JsonList>(*parent.value)) {
+            // В данном упрощённом варианте берем первый элемент
+            const auto& vec = std::get<JsonList>(*parent.value);
+            if (!vec.empty()) {
+                auto childIt = vec[0].find(varName.substr(dotPos + 1));
+                if (childIt != vec[0].end()) {
+                    applyFilter(childIt->second, filter, output);
                 }
-            } else {
-                replacement = "";
-            }
-        } else {
-            if (std::holds_alternative<std::string>(it->second)) {
-                replacement = std::get<std::string>(it->second);
-            } else if (std::holds_alternative<bool>(it->second)) {
-                replacement = std::get<bool>(it->second) ? "true" : "false";
-            } else if (std::holds_alternative<std::vector<std::map<std::string, std::string>>>(it->second)) {
-                replacement = "[object]";
             }
         }
-
-        if (!filter.empty()) {
-            replacement = applyFilters(replacement, filter);
-        }
-
-        result.replace(start, (end - start) + 2, replacement);
-        startPos = start + replacement.size();
+        return;
     }
-    return result;
-}
 
-void TemplateEngine::renderLoop(const std::string& loopVar, const std::string& listName, const std::string& innerBlock, const Context& context, std::string& output) const {
-    auto it = context.find(listName);
-    if (it == context.end()) return;
-    if (!std::holds_alternative<std::vector<std::map<std::string, std::string>>>(it->second)) return;
-
-    const auto& vec = std::get<std::vector<std::map<std::string, std::string>>>(it->second);
-    for (const auto& item : vec) {
-        Context iterationContext = context;
-        for (auto &kv : item) {
-            iterationContext[loopVar + "." + kv.first] = kv.second;
-        }
-        output += renderTemplateContent(innerBlock, iterationContext);
+    const ValueType& value = *ref.value;
+    if (std::holds_alternative<std::string>(value)) {
+        applyFilter(std::get<std::string>(value), filter, output);
+    } else if (std::holds_alternative<bool>(value)) {
+        applyFilter(std::get<bool>(value) ? "true" : "false", filter, output);
+    } else if (std::holds_alternative<JsonList>(value)) {
+        applyFilter("[object]", filter, output);
     }
 }
 
-std::string TemplateEngine::processIf(const std::string& block, const Context& context) const {
-    size_t ifPos = block.find("{% if ");
-    if (ifPos == std::string::npos) return block;
-    size_t ifEnd = block.find("%}", ifPos);
-    if (ifEnd == std::string::npos) return block;
-
-    std::string condVar = trim(block.substr(ifPos + 6, ifEnd - (ifPos + 6)));
-    bool condition = evaluateCondition(condVar, context);
-
-    size_t endifPos = block.find("{% endif %}", ifEnd);
-    if (endifPos == std::string::npos) return block;
-
-    std::string inside = block.substr(ifEnd + 2, endifPos - (ifEnd + 2));
-    size_t elsePos = inside.find("{% else %}");
-
-    std::string chosen;
-    if (condition) {
-        // часть до else или вся строка если нет else
-        if (elsePos != std::string::npos) {
-            chosen = inside.substr(0, elsePos);
-        } else {
-            chosen = inside;
-        }
-    } else {
-        // если есть else
-        if (elsePos != std::string::npos) {
-            size_t elseEnd = elsePos + std::string("{% else %}").size();
-            chosen = inside.substr(elseEnd);
-        } else {
-            chosen = "";
-        }
+void TemplateEngine::renderLoop(const Node& node, const Scope& scope, const BlockMap& blocks, Output& output) const {
+    ValueRef ref = lookup(node.text, scope);
+    if (!ref.value || !std::holds_alternative<JsonList>(*ref.value)) return;
+
+    // Один кадр на весь цикл, на каждой итерации меняется только элемент
+    Scope frame;
+    frame.parent = &scope;
+    frame.loopVar = &node.loopVar;
+    for (const auto& item : std::get<JsonList>(*ref.value)) {
+        frame.item = &item;
+        renderNodes(node.children, frame, blocks, output);
     }
-
-    std::string result = block;
-    result.replace(ifPos, (endifPos - ifPos) + 11, chosen);
-    return result;
 }
 
-std::string TemplateEngine::processFor(const std::string& block, const Context& context) const {
-    // Регулярное выражение для поиска блока for
-    static const std::regex forRegex(R"(\{% for\s+(\w+)\s+in\s+(\w+)\s+%\})");
-    static const std::regex endForRegex(R"(\{% endfor %\})");
-
-    std::smatch forMatch;
-    std::smatch endForMatch;
-
-    // Поиск начала блока for
-    if (!std::regex_search(block, forMatch, forRegex)) {
-        // Если не найдено, возвращаем исходный блок
-        return block;
+void TemplateEngine::renderInclude(const std::string& includeName, const Scope& scope, std::string& output) const {
+    std::shared_ptr<const Program> program = findTemplate(includeName);
+    if (!program || program->source.empty()) {
+        output += "[Error: Included template not found: " + includeName + "]";
+        return;
     }
 
-    // Извлечение переменных из выражения for
-    std::string varName = forMatch[1];
-    std::string listName = forMatch[2];
-
-    // Позиции начала и конца блока for
-    size_t forStartPos = forMatch.position(0);
-    size_t forEndPos = forMatch.position(0) + forMatch.length(0);
-
-    // Поиск соответствующего {% endfor %}
-    std::string remainingBlock = block.substr(forEndPos);
-    if (!std::regex_search(remainingBlock, endForMatch, endForRegex)) {
-        // Если не найден {% endfor %}, возвращаем исходный блок
-        return block;
+    // Создаём ключ для кэша
+    size_t seed = 0;
+    hashDependencies(*program, scope, seed, 0);
+    TemplateEngine::IncludeCacheKey cacheKey{ includeName, seed };
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto cacheIt = includeCache.find(cacheKey);
+        if (cacheIt != includeCache.end()) {
+            // Используем кэшированное значение
+            includeLru.splice(includeLru.begin(), includeLru, cacheIt->second);
+            output += cacheIt->second->second;
+            return;
+        }
     }
 
-    size_t endForPos = forEndPos + endForMatch.position(0);
-    size_t endForLength = endForMatch.length(0);
-
-    // Извлечение внутреннего содержимого между {% for %} и {% endfor %}
-    size_t innerStart = forEndPos;
-    size_t innerLength = endForPos - forEndPos;
-    std::string innerBlock = block.substr(innerStart, innerLength);
-
-    // Проверка наличия списка в контексте
-    auto listIt = context.find(listName);
-    if ((listName[0] == '_' && listName[1] == '_') || listIt == context.end() || !std::holds_alternative<std::vector<std::map<std::string, std::string>>>(listIt->second)) {
-        // Если список не найден или имеет неверный тип, заменяем блок на пустую строку
-        std::string result = block;
-        result.erase(forStartPos, (endForPos + endForLength) - forStartPos);
-        return result;
+    // Рендерим содержимое включаемого шаблона
+    std::string renderedContent;
+    try {
+        Output included;
+        renderProgram(program, scope, included);
+        renderedContent = std::move(included.buffer);
+    } catch (const std::exception& e) {
+        renderedContent = "[Error rendering included template: " + includeName + "]";
     }
+    output += renderedContent;
+
+    // Сохраняем результат в кэш
+    if (renderedContent.size() > includeCacheMaxBytes) return;
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto cacheIt = includeCache.find(cacheKey);
+    if (cacheIt != includeCache.end()) return; // уже добавлен другим потоком
+    includeCacheBytes += renderedContent.size();
+    includeLru.emplace_front(cacheKey, std::move(renderedContent));
+    includeCache.emplace(std::move(cacheKey), includeLru.begin());
+    evictIncludes();
+}
 
-    // Получение списка из контекста
-    const auto& list = std::get<std::vector<std::map<std::string, std::string>>>(listIt->second);
-
-    // Рендеринг цикла
-    std::string renderedLoop;
-    renderedLoop.reserve(list.size() * innerBlock.size()); // Предварительное резервирование для повышения производительности
-
-    for (const auto& item : list) {
-        Context iterationContext = context; // Копирование текущего контекста
-        for (const auto& [key, value] : item) {
-            iterationContext[varName + "." + key] = value;
-        }
-        renderedLoop += renderTemplateContent(innerBlock, iterationContext);
+// Вытесняет давно не использованные записи; вызывается под cacheMutex
+void TemplateEngine::evictIncludes() const {
+    while (!includeLru.empty() &&
+           (includeCache.size() > includeCacheMaxEntries || includeCacheBytes > includeCacheMaxBytes)) {
+        auto& last = includeLru.back();
+        includeCacheBytes -= last.second.size();
+        includeCache.erase(last.first);
+        includeLru.pop_back();
     }
-
-    // Замена исходного блока на отрендеренный цикл
-    std::string result = block;
-    result.replace(forStartPos, (endForPos + endForLength) - forStartPos, renderedLoop);
-    return result;
 }
 
-std::string TemplateEngine::processInclude(const std::string& block, const Context& context) const {
-    std::string result = block;
-
-    // Регулярное выражение для поиска директив include, например: {% include "header.html" %}
-    static const std::regex includeRegex("\\{\\%\\s*include\\s*\"([^\"]+)\"\\s*\\%\\}");
-    std::smatch match;
-    std::string::const_iterator searchStart(result.cbegin());
-
-    // Используем std::regex_iterator для перебора всех совпадений
-    std::regex_iterator<std::string::const_iterator> rit(searchStart, result.cend(), includeRegex);
-    std::regex_iterator<std::string::const_iterator> rend;
-
-    // Смещение для корректной замены подстрок
-    size_t offset = 0;
-
-    while (rit != rend) {
-        match = *rit;
-        std::string includeName = match[1];  // Имя шаблона внутри кавычек
-
-        // Вычисляем хэш контекста
-        size_t contextHash = hashContext(context);
-
-        // Создаём ключ для кэша
-        TemplateEngine::IncludeCacheKey cacheKey{ includeName, contextHash };
-
-        std::string renderedContent;
-
-        {
-            std::lock_guard<std::mutex> lock(cacheMutex);
-            auto cacheIt = includeCache.find(cacheKey);
-            if (cacheIt != includeCache.end()) {
-                // Используем кэшированное значение
-                renderedContent = cacheIt->second;
-            }
-        }
-
-        if (renderedContent.empty()) {
-            // Получаем содержимое включаемого шаблона
-            std::string incContent = getTemplateContent(includeName);
-            if (incContent.empty()) {
-                // Заменяем директиву на сообщение об ошибке
-                std::string errorMsg = "[Error: Included template not found: " + includeName + "]";
-                size_t matchPos = match.position(0) + offset;
-                size_t matchLength = match.length(0);
-                result.replace(matchPos, matchLength, errorMsg);
-                offset += errorMsg.length() - matchLength;
-
-                // Обновляем итератор с учётом изменений в строке
-                rit = std::regex_iterator<std::string::const_iterator>(
-                    result.cbegin() + matchPos + errorMsg.length(),
-                    result.cend(),
-                    includeRegex
-                );
-                continue;
-            }
-
-            // Рендерим содержимое включаемого шаблона
-            try {
-                renderedContent = renderTemplateContent(incContent, context);
-            } catch (const std::exception& e) {
-                // Заменяем директиву на сообщение об ошибке
-                std::string errorMsg = "[Error rendering included template: " + includeName + "]";
-                renderedContent = errorMsg;
-            }
-
-            // Сохраняем результат в кэш
-            {
-                std::lock_guard<std::mutex> lock(cacheMutex);
-                includeCache[cacheKey] = renderedContent;
-            }
-        }
-
-        // Вычисляем позицию для замены
-        size_t matchPos = match.position(0) + offset;
-        size_t matchLength = match.length(0);
-
-        // Выполняем замену в результирующей строке
-        result.replace(matchPos, matchLength, renderedContent);
-
-        // Обновляем смещение
-        offset += renderedContent.length() - matchLength;
-
-        // Обновляем итератор, учитывая изменённую строку
-        rit = std::regex_iterator<std::string::const_iterator>(
-            result.cbegin() + matchPos + renderedContent.length(),
-            result.cend(),
-            includeRegex
-        );
-    }
+void TemplateEngine::setIncludeCacheLimits(size_t maxEntries, size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    includeCacheMaxEntries = maxEntries;
+    includeCacheMaxBytes = maxBytes;
+    evictIncludes();
+}
 
-    return result;
-}
-
-std::string TemplateEngine::applyFilters(const std::string& value, const std::string& filter) const {
-    if (filter == "upper") {
-        std::string up = value;
-        std::transform(up.begin(), up.end(), up.begin(), ::toupper);
-        return up;
-    } else if (filter == "lower") {
-        std::string low = value;
-        std::transform(low.begin(), low.end(), low.begin(), ::tolower);
-        return low;
-    } else if (filter == "escape") {
-        std::string esc;
-        for (auto c : value) {
-            if (c == '<') esc += "&lt;";
-            else if (c == '>') esc += "&gt;";
-            else if (c == '&') esc += "&amp;";
-            else if (c == '"') esc += "&quot;";
-            else esc += c;
+void TemplateEngine::applyFilter(const std::string& value, Node::Filter filter, std::string& output) {
+    switch (filter) {
+    case Node::UPPER:
+        for (unsigned char c : value) output += (char)std::toupper(c);
+        break;
+    case Node::LOWER:
+        for (unsigned char c : value) output += (char)std::tolower(c);
+        break;
+    case Node::ESCAPE:
+        for (char c : value) {
+            if (c == '<') output += "&lt;";
+            else if (c == '>') output += "&gt;";
+            else if (c == '&') output += "&amp;";
+            else if (c == '"') output += "&quot;";
+            else output += c;
         }
-        return esc;
+        break;
+    default:
+        output += value;
     }
-    return value;
-}
-
-std::string TemplateEngine::trim(const std::string& s) const {
-    std::string r = s;
-    r.erase(r.begin(), std::find_if(r.begin(), r.end(), [](unsigned char ch) {
-        return !std::isspace(ch);
-    }));
-    r.erase(std::find_if(r.rbegin(), r.rend(), [](unsigned char ch) {
-        return !std::isspace(ch);
-    }).base(), r.end());
-    return r;
-}
-
-// Новый метод для извлечения блоков из шаблона
-std::map<std::string, std::string> TemplateEngine::extractBlocks(const std::string& content) const {
-    std::map<std::string, std::string> blocks;
-    std::regex blockRegex(R"(\{% block (\w+) %\}([\s\S]*?)\{% endblock %\})");
-    std::smatch match;
-    std::string::const_iterator searchStart(content.cbegin());
-    while (std::regex_search(searchStart, content.cend(), match, blockRegex)) {
-        std::string blockName = match[1];
-        std::string blockContent = match[2];
-        blocks[blockName] = blockContent;
-        searchStart = match.suffix().first;
-    }
-    return blocks;
-}
-
-// Новый метод для обработки директивы extends
-std::string TemplateEngine::processExtends(const std::string& content, const Context& context, std::map<std::string, std::string>& childBlocks) const {
-    std::regex extendsRegex("\\{% extends\\s+\"([^\"]+)\"\\s*%\\}");
-    std::smatch match;
-    if (std::regex_search(content, match, extendsRegex)) {
-        std::string baseTemplateName = match[1];
-        std::string baseContent = getTemplateContent(baseTemplateName);
-        if (baseContent.empty()) {
-            return "Base template not found: " + baseTemplateName;
-        }
+}
 
-        // Извлекаем блоки из базового шаблона
-        std::map<std::string, std::string> baseBlocks = extractBlocks(baseContent);
+void TemplateEngine::RenderContext::text(const char* data, size_t size) {
+    if (output.failed) return;
+    output.buffer.append(data, size);
+    checkFlush();
+}
 
-        // Извлекаем блоки из дочернего шаблона
-        std::map<std::string, std::string> childExtractedBlocks = extractBlocks(content);
-        // Перезаписываем блоки базового шаблона блоками из дочернего шаблона
-        for (const auto& [name, blk] : childExtractedBlocks) {
-            baseBlocks[name] = blk;
-        }
+void TemplateEngine::RenderContext::variable(const std::string& name, Node::Filter filter) {
+    if (output.failed) return;
+    engine.renderVariable(name, filter, scope, output.buffer);
+    checkFlush();
+}
 
-        // Заменяем блоки в базовом шаблоне на соответствующие из дочернего
-        std::string renderedBase = baseContent;
-        for (const auto& [name, blk] : baseBlocks) {
-            std::regex blockPlaceholder(R"(\{% block\s+)" + name + R"(\s*%\}[\s\S]*?\{% endblock %\})");
-            renderedBase = std::regex_replace(renderedBase, blockPlaceholder, blk);
-        }
+bool TemplateEngine::RenderContext::condition(const std::string& name) {
+    return engine.evaluateCondition(name, scope);
+}
 
-        // Рендерим объединённый шаблон
-        return renderTemplateContent(renderedBase, context);
+void TemplateEngine::RenderContext::loop(const std::string& list, const std::string& loopVar, CompiledRender body) {
+    ValueRef ref = engine.lookup(list, scope);
+    if (!ref.value || !std::holds_alternative<JsonList>(*ref.value)) return;
+
+    Scope frame;
+    frame.parent = &scope;
+    frame.loopVar = &loopVar;
+    RenderContext child(engine, frame, blocks, output);
+    for (const auto& item : std::get<JsonList>(*ref.value)) {
+        if (output.failed) return;
+        frame.item = &item;
+        body(child);
     }
-    return content;
 }
 
-// Реализация метода обработки комментариев
-std::string TemplateEngine::processComments(const std::string& content) const {
-    std::string result = content;
-
-    // Регулярное выражение для поиска комментариев: {# комментарий #}
-    static const std::regex commentRegex("\\{\\#([\\s\\S]*?)\\#\\}");
-
-    // Удаляем все комментарии из шаблона
-    result = std::regex_replace(result, commentRegex, "");
+void TemplateEngine::RenderContext::include(const std::string& name) {
+    if (output.failed) return;
+    engine.renderInclude(name, scope, output.buffer);
+    checkFlush();
+}
 
-    return result;
+void TemplateEngine::RenderContext::block(const std::string& name, CompiledRender body) {
+    auto it = blocks.find(name);
+    if (it != blocks.end()) {
+        engine.renderNodes(it->second->children, scope, blocks, output);
+    } else {
+        body(*this);
+    }
 }
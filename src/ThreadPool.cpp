@@ -1,6 +1,56 @@
 #include "FlaskCpp/ThreadPool.h"
 #include <stdexcept>
 
+// Пул и рабочий поток, которым принадлежит текущий поток (nullptr для внешних потоков)
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local void* currentWorker = nullptr;
+
+// Кэш узлов для задач в собственных деках рабочих потоков: узел освобождает
+// поток, выполнивший задачу, и использует его повторно, так что в установившемся
+// режиме память не выделяется
+static const size_t NODE_CACHE_SIZE = 256;
+
+struct TaskNodeCache {
+    std::vector<void*> nodes;
+    TaskNodeCache() { nodes.reserve(NODE_CACHE_SIZE); }
+    ~TaskNodeCache() { for (void* node: nodes) ::operator delete(node); }
+};
+static thread_local TaskNodeCache nodeCache;
+
+template<class T>
+static T* acquireNode(T&& task)
+{
+    if (nodeCache.nodes.empty()) return new T(std::move(task));
+    void* node = nodeCache.nodes.back();
+    nodeCache.nodes.pop_back();
+    return new (node) T(std::move(task));
+}
+
+template<class T>
+static void releaseNode(T* node, T& task)
+{
+    task = std::move(*node);
+    node->~T();
+    if (nodeCache.nodes.size() < NODE_CACHE_SIZE) nodeCache.nodes.push_back(node);
+    else ::operator delete(node);
+}
+
+static inline int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Сколько раз простаивающий поток ищет задачи, прежде чем заснуть
+static const size_t SPIN_ROUNDS = 64;
+static const size_t INJECTION_CAPACITY = 4096;
+
+// Автомасштабирование
+static const auto MONITOR_INTERVAL = std::chrono::milliseconds(10);
+static const uint64_t SCALE_UP_WAIT_NS = 2000000;   // задержка очереди, при которой добавляем потоки (2 мс)
+static const double LOW_UTILISATION = 0.3;          // ниже — пул считается недогруженным
+static const int64_t RETIRE_DELAY_NS = 1000000000;  // сколько должна длиться недогрузка перед уменьшением (1 с)
+
 // Конструктор
 ThreadPool::ThreadPool(size_t minThreads, size_t maxThreads, bool verbose)
     : stop(false), minThreads(minThreads), maxThreads(maxThreads), currentThreads(0), verbose(verbose), threadsToTerminate(0)
@@ -9,6 +59,11 @@ ThreadPool::ThreadPool(size_t minThreads, size_t maxThreads, bool verbose)
         throw std::invalid_argument("minThreads cannot be greater than maxThreads");
     }
 
+    slots.reset(new Worker[maxThreads ? maxThreads : 1]);
+    for (int lane = 0; lane < NUM_LANES; ++lane) {
+        injection[lane].reset(new MpmcQueue<Task>(INJECTION_CAPACITY));
+    }
+
     // Запускаем минимальное количество потоков
     for (size_t i = 0; i < minThreads; ++i) {
         addThread();
@@ -24,77 +79,261 @@ ThreadPool::~ThreadPool()
     shutdown();
 }
 
+int ThreadPool::laneOf(int priority)
+{
+    if (priority <= 0) return 0;
+    if (priority >= NUM_LANES - 1) return NUM_LANES - 1;
+    return priority;
+}
+
 // Добавление нового потока
 void ThreadPool::addThread()
 {
-    workers.emplace_back([this]() {
-        while (true) {
-            PrioritizedTask pt;
-            {
-                std::unique_lock<std::mutex> lock(this->queueMutex);
-                this->condition.wait(lock, [this]() { return this->stop.load() || !this->tasks.empty() || this->threadsToTerminate.load() > 0; });
-                
-                if (this->stop.load() && this->tasks.empty())
-                    return;
-                
-                if (this->threadsToTerminate.load() > 0 && this->tasks.empty()) {
-                    this->threadsToTerminate.fetch_sub(1);
-                    currentThreads.fetch_sub(1);
-                    if (verbose) {
-                        std::cout << "ThreadPool: current size: " << currentThreads.load() << std::endl;
-                    }
-                    return;
-                }
-
-                if (!this->tasks.empty()) {
-                    pt = std::move(this->tasks.top());
-                    this->tasks.pop();
-                } else {
-                    continue;
-                }
-            }
-            pt.task();
+    // Ищем свободный слот (слоты завершившихся потоков освобождает reapFinished)
+    size_t index = maxThreads;
+    for (size_t i = 0; i < maxThreads; ++i) {
+        bool expected = false;
+        if (slots[i].used.compare_exchange_strong(expected, true)) {
+            index = i;
+            break;
         }
-    });
+    }
+    if (index == maxThreads) return;
+
+    size_t count = slotCount.load();
+    while (count < index + 1 && !slotCount.compare_exchange_weak(count, index + 1)) {}
+
+    Worker* self = &slots[index];
     currentThreads.fetch_add(1);
+    self->thread = std::thread([this, self, index]() {
+        workerLoop(self, index);
+    });
     if (verbose) {
         std::cout << "ThreadPool: Добавлен поток. Текущий размер пула: " << currentThreads.load() << std::endl;
     }
 }
 
-// Метод мониторинга нагрузки
+void ThreadPool::submit(int priority, InlineTask fn)
+{
+    // Счётчик увеличивается до проверки stop: если shutdown() уже начался,
+    // рабочие потоки не завершатся, пока задача не будет выполнена
+    pendingTasks.fetch_add(1);
+    if (stop.load()) {
+        pendingTasks.fetch_sub(1);
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+    }
+
+    int lane = laneOf(priority);
+    bool pushed = false;
+    Task task{std::move(fn), nowNs()};
+
+    // Задачи из рабочих потоков кладём в собственный дек
+    if (currentPool == this) {
+        Worker* self = static_cast<Worker*>(currentWorker);
+        Task* local = acquireNode(std::move(task));
+        pushed = self->deques[lane].push(local);
+        if (!pushed) releaseNode(local, task);
+    }
+    if (!pushed && !injection[lane]->push(std::move(task))) {
+        std::lock_guard<std::mutex> lock(overflowMutex);
+        overflow[lane].push_back(std::move(task));
+        overflowCount.fetch_add(1);
+    }
+
+    if (sleepers.load() > 0) {
+        { std::lock_guard<std::mutex> lock(parkMutex); }
+        parkCondition.notify_one();
+    }
+}
+
+bool ThreadPool::findTask(Worker* self, size_t index, Task& task)
+{
+    size_t count = slotCount.load(std::memory_order_acquire);
+    for (int lane = 0; lane < NUM_LANES; ++lane) {
+        // 1. Свой дек
+        if (Task* local = self->deques[lane].pop()) {
+            releaseNode(local, task);
+            pendingTasks.fetch_sub(1);
+            return true;
+        }
+
+        // 2. Глобальная очередь
+        if (injection[lane]->pop(task)) {
+            pendingTasks.fetch_sub(1);
+            return true;
+        }
+        if (overflowCount.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(overflowMutex);
+            if (!overflow[lane].empty()) {
+                task = std::move(overflow[lane].front());
+                overflow[lane].pop_front();
+                overflowCount.fetch_sub(1);
+                pendingTasks.fetch_sub(1);
+                return true;
+            }
+        }
+
+        // 3. Перехват из деков других потоков
+        for (size_t i = 1; i < count; ++i) {
+            Worker& victim = slots[(index + i) % count];
+            if (!victim.used.load(std::memory_order_relaxed)) continue;
+            if (Task* stolen = victim.deques[lane].steal()) {
+                releaseNode(stolen, task);
+                pendingTasks.fetch_sub(1);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::park()
+{
+    std::unique_lock<std::mutex> lock(parkMutex);
+    sleepers.fetch_add(1);
+    if (pendingTasks.load() == 0 && !stop.load() && threadsToTerminate.load() <= 0) {
+        parkCondition.wait_for(lock, std::chrono::milliseconds(100));
+    }
+    sleepers.fetch_sub(1);
+}
+
+void ThreadPool::workerLoop(Worker* self, size_t index)
+{
+    currentPool = this;
+    currentWorker = self;
+
+    size_t idle = 0;
+    while (true) {
+        Task task;
+        if (findTask(self, index, task)) {
+            idle = 0;
+            int64_t start = nowNs();
+            uint64_t wait = start > task.enqueuedNs ? start - task.enqueuedNs : 0;
+            if (wait > self->maxWaitNs.load(std::memory_order_relaxed))
+                self->maxWaitNs.store(wait, std::memory_order_relaxed);
+
+            self->busy.store(true, std::memory_order_relaxed);
+            task.fn();
+            task.fn.reset();
+            self->busy.store(false, std::memory_order_relaxed);
+            self->busyNs.fetch_add(nowNs() - start, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (stop.load() && pendingTasks.load() == 0)
+            break;
+
+        int terminate = threadsToTerminate.load();
+        if (terminate > 0 && threadsToTerminate.compare_exchange_strong(terminate, terminate - 1)) {
+            currentThreads.fetch_sub(1);
+            if (verbose) {
+                std::cout << "ThreadPool: current size: " << currentThreads.load() << std::endl;
+            }
+            break;
+        }
+
+        if (++idle < SPIN_ROUNDS) {
+            std::this_thread::yield();
+            continue;
+        }
+        park();
+    }
+
+    // Свои деки пусты: в них кладёт задачи только этот поток.
+    // Слот освободится после join в reapFinished()
+    self->finished.store(true);
+    currentPool = nullptr;
+    currentWorker = nullptr;
+}
+
+// Присоединяет завершившиеся потоки и освобождает их слоты
+void ThreadPool::reapFinished()
+{
+    size_t count = slotCount.load();
+    for (size_t i = 0; i < count; ++i) {
+        Worker& w = slots[i];
+        if (w.finished.load()) {
+            if (w.thread.joinable()) w.thread.join();
+            w.maxWaitNs.store(0);
+            w.finished.store(false);
+            w.used.store(false);
+        }
+    }
+}
+
+// Метод мониторинга нагрузки.
+// Каждые MONITOR_INTERVAL собирает задержку очереди (от постановки до начала выполнения)
+// и загрузку потоков. Потоки добавляются сразу, как только задачи начинают ждать или
+// все потоки заняты; уменьшение — только после RETIRE_DELAY_NS непрерывной недогрузки.
 void ThreadPool::monitorLoad()
 {
-    while (!stop.load()) {
-        std::this_thread::sleep_for(std::chrono::seconds(5));
+    uint64_t lastBusyNs = 0;
+    int64_t lastTick = nowNs();
+    int64_t quietNs = 0;
 
-        size_t taskCount;
+    while (!stop.load()) {
         {
-            std::lock_guard<std::mutex> lock(queueMutex);
-            taskCount = tasks.size();
+            std::unique_lock<std::mutex> lock(monitorMutex);
+            monitorCondition.wait_for(lock, MONITOR_INTERVAL, [this]() { return stop.load(); });
+        }
+        if (stop.load()) break;
+
+        reapFinished();
+
+        int64_t now = nowNs();
+        int64_t elapsed = std::max<int64_t>(1, now - lastTick);
+        lastTick = now;
+
+        uint64_t busyNs = 0, maxWait = 0;
+        size_t busyThreads = 0;
+        size_t count = slotCount.load();
+        for (size_t i = 0; i < count; ++i) {
+            Worker& w = slots[i];
+            // busyNs не сбрасывается при освобождении слота, поэтому сумма монотонна
+            busyNs += w.busyNs.load(std::memory_order_relaxed);
+            if (!w.used.load()) continue;
+            maxWait = std::max<uint64_t>(maxWait, w.maxWaitNs.exchange(0, std::memory_order_relaxed));
+            if (w.busy.load(std::memory_order_relaxed)) ++busyThreads;
         }
+        uint64_t busyDelta = busyNs > lastBusyNs ? busyNs - lastBusyNs : 0;
+        lastBusyNs = busyNs;
+
+        size_t current = currentThreads.load();
+        size_t taskCount = pendingTasks.load();
+        double utilisation = current ? (double)busyDelta / ((double)elapsed * current) : 1.0;
 
         // Логика увеличения пула потоков
-        if (taskCount > currentThreads.load() && currentThreads.load() < maxThreads) {
-            size_t threadsToAdd = std::min(taskCount - currentThreads.load(), maxThreads - currentThreads.load());
+        bool saturated = taskCount > 0 && (maxWait > SCALE_UP_WAIT_NS || busyThreads >= current);
+        if (saturated && current < maxThreads) {
+            size_t idleThreads = current > busyThreads ? current - busyThreads : 0;
+            size_t threadsToAdd = taskCount > idleThreads ? taskCount - idleThreads : 1;
+            threadsToAdd = std::min(threadsToAdd, maxThreads - current);
             for (size_t i = 0; i < threadsToAdd; ++i) {
                 addThread();
-                if (verbose) {
-                    std::cout << "ThreadPool: Добавлен поток. Текущий размер пула: " << currentThreads.load() << std::endl;
-                }
             }
+            quietNs = 0;
+            if (verbose) {
+                std::cout << "ThreadPool: Добавлено потоков: " << threadsToAdd << ". Текущий размер пула: " << currentThreads.load() << std::endl;
+            }
+            continue;
         }
 
-        // Логика уменьшения пула потоков
-        else if (taskCount < currentThreads.load() && currentThreads.load() > minThreads) {
-            size_t excessThreads = currentThreads.load() - minThreads;
-            // Решаем уменьшить пул на 1 поток за раз для плавности
-            size_t threadsToRemove = 1;
-            if (excessThreads < threadsToRemove) {
-                threadsToRemove = excessThreads;
-            }
+        // Логика уменьшения пула потоков (с гистерезисом)
+        if (taskCount == 0 && maxWait < SCALE_UP_WAIT_NS && utilisation < LOW_UTILISATION) {
+            quietNs += elapsed;
+        } else {
+            quietNs = 0;
+        }
+
+        if (quietNs >= RETIRE_DELAY_NS && current > minThreads && threadsToTerminate.load() <= 0) {
+            // Убираем половину лишних потоков за раз
+            size_t threadsToRemove = std::max<size_t>(1, (current - minThreads) / 2);
             threadsToTerminate.fetch_add(threadsToRemove);
-            condition.notify_all(); // Уведомляем все потоки о возможном завершении
+            {
+                std::lock_guard<std::mutex> lock(parkMutex);
+            }
+            parkCondition.notify_all(); // Уведомляем все потоки о возможном завершении
+            quietNs = 0;
             if (verbose) {
                 std::cout << "ThreadPool: Запрошено завершение " << threadsToRemove << " потока(ов). Текущий размер пула: " << currentThreads.load() << std::endl;
             }
@@ -109,14 +348,21 @@ void ThreadPool::shutdown()
     {
         bool expected = false;
         if(stop.compare_exchange_strong(expected, true)) {
-            condition.notify_all();
-            // std::cout << "num workers: " << workers.size() << std::endl;
-            for(std::thread &worker: workers)
-                if(worker.joinable())
-                    worker.join();
-            // std::cout << "stop monitor thread" << std::endl;
+            {
+                std::lock_guard<std::mutex> lock(parkMutex);
+            }
+            parkCondition.notify_all();
+            {
+                std::lock_guard<std::mutex> lock(monitorMutex);
+            }
+            monitorCondition.notify_all();
+            // Сначала поток мониторинга, чтобы новые потоки больше не создавались
             if(monitorThread.joinable())
                 monitorThread.join();
+            size_t count = slotCount.load();
+            for (size_t i = 0; i < count; ++i)
+                if (slots[i].thread.joinable())
+                    slots[i].thread.join();
             if (verbose) {
                 std::cout << "ThreadPool: all stopped." << std::endl;
             }
@@ -126,8 +372,8 @@ void ThreadPool::shutdown()
     {
         std::cerr << e.what() << '\n';
     }
-    
-    
+
+
 }
 
 size_t ThreadPool::getMinThreads()
@@ -138,4 +384,9 @@ size_t ThreadPool::getMinThreads()
 size_t ThreadPool::getMaxThreads()
 {
     return maxThreads;
-}
\ No newline at end of file
+}
+
+size_t ThreadPool::getThreadCount()
+{
+    return currentThreads.load();
+}
@@ -0,0 +1,370 @@
+#include "FlaskCpp/WebSocket.h"
+#include "FlaskCpp/EventLoop.h"
+#include "FlaskCpp/utils/urlSafeSerializer.h"
+#include <cstring>
+
+static const char WEBSOCKET_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// 按8字节一组异或掩码，剩余部分逐字节处理
+static void unmask(char* data, size_t size, const unsigned char* mask)
+{
+    unsigned char key[8];
+    memcpy(key, mask, 4);
+    memcpy(key + 4, mask, 4);
+    uint64_t key64;
+    memcpy(&key64, key, 8);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t v;
+        memcpy(&v, data + i, 8);
+        v ^= key64;
+        memcpy(data + i, &v, 8);
+    }
+    for (; i < size; ++i) {
+        data[i] ^= mask[i & 3];
+    }
+}
+
+// 拒绝过长编码、代理区和超出 U+10FFFF 的码点
+static bool isValidUtf8(std::string_view s)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s.data());
+    size_t n = s.size(), i = 0;
+    while (i < n) {
+        // ASCII 快速路径
+        if (i + 8 <= n) {
+            uint64_t v;
+            memcpy(&v, p + i, 8);
+            if (!(v & 0x8080808080808080ULL)) {
+                i += 8;
+                continue;
+            }
+        }
+        unsigned char c = p[i];
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+        size_t len;
+        uint32_t cp;
+        if ((c & 0xE0) == 0xC0) { len = 2; cp = c & 0x1F; }
+        else if ((c & 0xF0) == 0xE0) { len = 3; cp = c & 0x0F; }
+        else if ((c & 0xF8) == 0xF0) { len = 4; cp = c & 0x07; }
+        else return false;
+        if (i + len > n) return false;
+        for (size_t k = 1; k < len; ++k) {
+            if ((p[i + k] & 0xC0) != 0x80) return false;
+            cp = (cp << 6) | (p[i + k] & 0x3F);
+        }
+        if ((len == 2 && cp < 0x80) || (len == 3 && cp < 0x800) || (len == 4 && cp < 0x10000) ||
+            cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+        {
+            return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+// 关闭帧中允许出现的状态码（RFC 6455 7.4）
+static bool isValidCloseCode(uint16_t code)
+{
+    if (code >= 3000 && code <= 4999) return true;
+    return code >= 1000 && code <= 1014 && code != 1004 && code != 1005 && code != 1006;
+}
+
+static std::string base64Encode(std::string_view data)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((data.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        uint32_t v = ((unsigned char)data[i] << 16) | ((unsigned char)data[i + 1] << 8) | (unsigned char)data[i + 2];
+        out += table[v >> 18];
+        out += table[(v >> 12) & 0x3F];
+        out += table[(v >> 6) & 0x3F];
+        out += table[v & 0x3F];
+    }
+    if (i < data.size()) {
+        uint32_t v = (unsigned char)data[i] << 16;
+        if (i + 1 < data.size()) v |= (unsigned char)data[i + 1] << 8;
+        out += table[v >> 18];
+        out += table[(v >> 12) & 0x3F];
+        out += i + 1 < data.size() ? table[(v >> 6) & 0x3F] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+WebSocketParser::Result WebSocketParser::fail(uint16_t code)
+{
+    errorCode_ = code;
+    return RESULT_ERROR;
+}
+
+WebSocketParser::Result WebSocketParser::parse(const char* data, size_t size, size_t& consumed)
+{
+    consumed = 0;
+    if (complete_) {
+        message_.clear();
+        complete_ = false;
+    }
+
+    while (true) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data + consumed);
+        size_t avail = size - consumed;
+        if (avail < 2) return RESULT_NEED_MORE;
+
+        bool fin = p[0] & 0x80;
+        unsigned opcode = p[0] & 0x0F;
+        // 没有协商扩展，RSV 必须为0；客户端发送的帧必须带掩码
+        if (p[0] & 0x70) return fail(1002);
+        if (!(p[1] & 0x80)) return fail(1002);
+
+        uint64_t length = p[1] & 0x7F;
+        size_t header = 2;
+        if (length == 126) {
+            if (avail < 4) return RESULT_NEED_MORE;
+            length = (p[2] << 8) | p[3];
+            header = 4;
+        }
+        else if (length == 127) {
+            if (avail < 10) return RESULT_NEED_MORE;
+            length = 0;
+            for (int i = 2; i < 10; ++i) length = (length << 8) | p[i];
+            if (length >> 63) return fail(1002);
+            header = 10;
+        }
+
+        bool control = opcode & 0x8;
+        if (control) {
+            if (opcode != OP_CLOSE && opcode != OP_PING && opcode != OP_PONG) return fail(1002);
+            // 控制帧不能分片，负载不超过125字节
+            if (!fin || length > 125) return fail(1002);
+        }
+        else {
+            if (opcode > OP_BINARY) return fail(1002);
+            // 续帧必须在分片消息中，新的消息不能打断分片消息
+            if (opcode == OP_CONTINUATION ? !inMessage_ : inMessage_) return fail(1002);
+            if (length > maxMessageSize_ - message_.size()) return fail(1009);
+        }
+
+        if (avail - header < 4 || avail - header - 4 < length) return RESULT_NEED_MORE;
+        const unsigned char* mask = p + header;
+        const char* payload = reinterpret_cast<const char*>(p) + header + 4;
+        consumed += header + 4 + length;
+
+        if (control) {
+            control_.assign(payload, length);
+            unmask(&control_[0], length, mask);
+            controlOpcode_ = static_cast<Opcode>(opcode);
+            return RESULT_CONTROL;
+        }
+
+        size_t start = message_.size();
+        message_.append(payload, length);
+        unmask(&message_[start], length, mask);
+        if (opcode != OP_CONTINUATION) {
+            binary_ = opcode == OP_BINARY;
+            inMessage_ = true;
+        }
+        if (!fin) continue;
+
+        inMessage_ = false;
+        if (!binary_ && !isValidUtf8(message_)) return fail(1007);
+        complete_ = true;
+        return RESULT_MESSAGE;
+    }
+}
+
+std::string WebSocketParser::frame(Opcode opcode, std::string_view payload)
+{
+    std::string out;
+    size_t n = payload.size();
+    out.reserve(n + 10);
+    out += static_cast<char>(0x80 | opcode);
+    if (n < 126) {
+        out += static_cast<char>(n);
+    }
+    else if (n <= 0xFFFF) {
+        out += static_cast<char>(126);
+        out += static_cast<char>(n >> 8);
+        out += static_cast<char>(n);
+    }
+    else {
+        out += static_cast<char>(127);
+        for (int i = 7; i >= 0; --i) out += static_cast<char>((uint64_t)n >> (8 * i));
+    }
+    out.append(payload);
+    return out;
+}
+
+std::string WebSocketParser::closeFrame(uint16_t code, std::string_view reason)
+{
+    // 控制帧负载不超过125字节
+    std::string payload;
+    payload += static_cast<char>(code >> 8);
+    payload += static_cast<char>(code);
+    payload.append(reason.substr(0, 123));
+    return frame(OP_CLOSE, payload);
+}
+
+std::string WebSocketParser::acceptKey(std::string_view key)
+{
+    std::string data(key);
+    data += WEBSOCKET_GUID;
+    return base64Encode(URLSafeSerializer::sha1_hash(data));
+}
+
+WebSocket::WebSocket(const std::shared_ptr<Connection>& conn, OpenHandler onOpen,
+                     MessageHandler onMessage, CloseHandler onClose)
+    : conn_(conn), loop_(conn->loop), ip_(conn->ip),
+      onOpen_(std::move(onOpen)), onMessage_(std::move(onMessage)), onClose_(std::move(onClose))
+{
+}
+
+bool WebSocket::send(std::string_view text)
+{
+    return sendFrame(std::make_shared<const std::string>(WebSocketParser::frame(WebSocketParser::OP_TEXT, text)));
+}
+
+bool WebSocket::sendBinary(std::string_view data)
+{
+    return sendFrame(std::make_shared<const std::string>(WebSocketParser::frame(WebSocketParser::OP_BINARY, data)));
+}
+
+bool WebSocket::sendFrame(std::shared_ptr<const std::string> frame)
+{
+    std::shared_ptr<Connection> conn = conn_.lock();
+    if (!conn || !open_.load()) return false;
+    // 数据由事件循环线程发送；连接在此之前关闭时丢弃
+    EventLoop* loop = loop_;
+    loop->post([loop, conn, frame]() {
+        if (!loop->websockets.count(conn.get()) || conn->websocket->closeSent_) return;
+        if (!loop->sendBuffer(conn.get(), frame)) loop->removeDetached(conn.get());
+    });
+    return true;
+}
+
+void WebSocket::close(uint16_t code, std::string_view reason)
+{
+    std::shared_ptr<Connection> conn = conn_.lock();
+    if (!conn || !open_.exchange(false)) return;
+    EventLoop* loop = loop_;
+    std::string text(reason);
+    loop->post([loop, conn, code, text]() {
+        if (!loop->websockets.count(conn.get())) return;
+        WebSocket* self = conn->websocket.get();
+        if (self->closeSent_) return;
+        if (!self->sendClose(conn.get(), code, text, false)) loop->removeDetached(conn.get());
+    });
+}
+
+void WebSocket::opened()
+{
+    if (!onOpen_) return;
+    OpenHandler handler = std::move(onOpen_);
+    onOpen_ = nullptr;
+    try {
+        handler(shared_from_this());
+    } catch (...) {
+        close(1011);
+    }
+}
+
+void WebSocket::closed()
+{
+    open_.store(false);
+    if (!onClose_) return;
+    CloseHandler handler = std::move(onClose_);
+    onClose_ = nullptr;
+    try {
+        handler(shared_from_this(), closeCode_);
+    } catch (...) {
+    }
+}
+
+bool WebSocket::sendClose(Connection* conn, uint16_t code, std::string_view reason, bool disconnect)
+{
+    closeSent_ = true;
+    open_.store(false);
+    if (closeCode_ == 1006) closeCode_ = code ? code : 1005;
+
+    auto frame = std::make_shared<const std::string>(code ? WebSocketParser::closeFrame(code, reason) :
+                                                            WebSocketParser::frame(WebSocketParser::OP_CLOSE, ""));
+    if (!loop_->sendBuffer(conn, frame)) return false;
+    if (!disconnect) return true;
+    // 关闭帧发送完成后断开
+    if (conn->output.empty()) return false;
+    conn->closeAfterFlush = true;
+    return true;
+}
+
+bool WebSocket::onData(Connection* conn, std::string& buffer)
+{
+    WebSocketPtr self = shared_from_this();
+    size_t pos = 0;
+    bool keep = true;
+    while (keep && pos < buffer.size()) {
+        size_t used = 0;
+        WebSocketParser::Result result = parser_.parse(buffer.data() + pos, buffer.size() - pos, used);
+        pos += used;
+        if (result == WebSocketParser::RESULT_NEED_MORE) break;
+
+        if (result == WebSocketParser::RESULT_ERROR) {
+            keep = !closeSent_ && sendClose(conn, parser_.errorCode(), "", true);
+            pos = buffer.size();
+            break;
+        }
+
+        if (result == WebSocketParser::RESULT_MESSAGE) {
+            // 关闭帧发出之后收到的消息丢弃
+            if (closeSent_ || !onMessage_) continue;
+            try {
+                onMessage_(self, parser_.message(), parser_.binary());
+            } catch (...) {
+                keep = sendClose(conn, 1011, "", true);
+                pos = buffer.size();
+            }
+            continue;
+        }
+
+        const std::string& payload = parser_.controlPayload();
+        switch (parser_.controlOpcode()) {
+        case WebSocketParser::OP_PING:
+            if (!closeSent_) {
+                auto pong = std::make_shared<const std::string>(WebSocketParser::frame(WebSocketParser::OP_PONG, payload));
+                keep = loop_->sendBuffer(conn, pong);
+            }
+            break;
+        case WebSocketParser::OP_PONG:
+            break;
+        default:
+            {
+                // 关闭帧：回复相同的状态码后断开；已经发出过关闭帧时直接断开
+                uint16_t code = 1005;
+                bool valid = payload.size() != 1;
+                if (payload.size() >= 2) {
+                    code = ((unsigned char)payload[0] << 8) | (unsigned char)payload[1];
+                    valid = isValidCloseCode(code) && isValidUtf8(std::string_view(payload).substr(2));
+                }
+                if (closeSent_) {
+                    keep = false;
+                }
+                else if (!valid) {
+                    keep = sendClose(conn, 1002, "", true);
+                }
+                else {
+                    closeCode_ = code;
+                    keep = sendClose(conn, code == 1005 ? 0 : code, "", true);
+                }
+                pos = buffer.size();
+            }
+            break;
+        }
+    }
+    buffer.erase(0, pos);
+    return keep;
+}
@@ -608,7 +608,7 @@ int main(int argc, char** argv)
         for (auto& it: req.files)
         {
             std::ostringstream oss;
-            oss << it.first << ": size -> " << parse_size(it.second.data.size());
+            oss << it.first << ": size -> " << parse_size(it.second.size);
             app.log({0, oss.str(), __LINE__, __FILE__, __func__});
 
             std::string reason = flaskcpp::save_file(it.second, file_path);
@@ -658,10 +658,11 @@ int main(int argc, char** argv)
         std::string address = template_path + "index.html";
         if (isfile(address))
         {
-            auto res = app.renderTemplate("index.html", ctx_);
+            auto res = app.streamTemplate("index.html", std::move(ctx_), {FLASK_NO_CACHE});
             // std::map<std::string, std::string> cookies={};
-            
-            return flaskcpp::send_text(res, {FLASK_NO_CACHE});
+            if (res.type)
+                return res;
+            return flaskcpp::send_file(address, "", false, {FLASK_NO_CACHE});
             // return flaskcpp::send_file(address, "", false, {FLASK_NO_CACHE});
         }
         return flaskcpp::send_text(
@@ -708,9 +709,9 @@ int main(int argc, char** argv)
 
         if (isfile(address))
         {
-            auto res = app.renderTemplate(html_file, ctx_);
-            if (res.size())
-                return flaskcpp::send_text(res, {FLASK_NO_CACHE});
+            auto res = app.streamTemplate(html_file, std::move(ctx_), {FLASK_NO_CACHE});
+            if (res.type)
+                return res;
             return flaskcpp::send_file(address, "", false, {FLASK_NO_CACHE});
         }
 
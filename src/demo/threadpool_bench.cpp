@@ -0,0 +1,125 @@
+// Микробенчмарк пула потоков: задач в секунду для текущего ThreadPool (work stealing)
+// и прежней реализации (одна priority_queue под мьютексом).
+//
+// ./threadpool_bench [threads] [producers] [tasks_per_producer]
+
+#include <FlaskCpp/ThreadPool.h>
+#include <queue>
+#include <cstdlib>
+#include <iomanip>
+
+// Прежняя реализация ThreadPool без мониторинга нагрузки, для сравнения
+class LegacyThreadPool {
+public:
+    explicit LegacyThreadPool(size_t threads)
+    {
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this]() {
+                while (true) {
+                    PrioritizedTask pt;
+                    {
+                        std::unique_lock<std::mutex> lock(queueMutex);
+                        condition.wait(lock, [this]() { return stop || !tasks.empty(); });
+                        if (stop && tasks.empty()) return;
+                        pt = std::move(const_cast<PrioritizedTask&>(tasks.top()));
+                        tasks.pop();
+                    }
+                    pt.task();
+                }
+            });
+        }
+    }
+
+    ~LegacyThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for (auto& w: workers) w.join();
+    }
+
+    template<class F>
+    auto enqueue(int priority, F&& f) -> std::future<typename std::invoke_result<F>::type>
+    {
+        using return_type = typename std::invoke_result<F>::type;
+        auto task = std::make_shared< std::packaged_task<return_type()> >(std::forward<F>(f));
+        std::future<return_type> res = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            tasks.emplace(PrioritizedTask{priority, [task](){ (*task)(); }});
+        }
+        condition.notify_one();
+        return res;
+    }
+
+private:
+    struct PrioritizedTask {
+        int priority;
+        std::function<void()> task;
+        bool operator<(const PrioritizedTask& other) const { return priority > other.priority; }
+    };
+
+    std::vector<std::thread> workers;
+    std::priority_queue<PrioritizedTask> tasks;
+    std::mutex queueMutex;
+    std::condition_variable condition;
+    bool stop = false;
+};
+
+// Внешние потоки (как цикл событий) отправляют задачи, ждём выполнения всех
+template<class Submit>
+double run(Submit submit, size_t producers, size_t tasksPerProducer)
+{
+    std::atomic<size_t> done{0};
+    size_t total = producers * tasksPerProducer;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&submit, &done, tasksPerProducer, p]() {
+            for (size_t i = 0; i < tasksPerProducer; ++i) {
+                submit(1 + (int)((i + p) % 4), [&done]() {
+                    done.fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+        });
+    }
+    for (auto& t: threads) t.join();
+    while (done.load() < total) std::this_thread::yield();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return total / elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    size_t threads = argc > 1 ? atoi(argv[1]) : std::max(2u, std::thread::hardware_concurrency());
+    size_t producers = argc > 2 ? atoi(argv[2]) : 4;
+    size_t tasks = argc > 3 ? atoi(argv[3]) : 200000;
+
+    std::cout << "threads: " << threads << ", producers: " << producers
+              << ", tasks: " << producers * tasks << std::endl;
+
+    double legacy, stealing, posted;
+    {
+        LegacyThreadPool pool(threads);
+        legacy = run([&pool](int priority, auto f) { pool.enqueue(priority, f); }, producers, tasks);
+    }
+    {
+        ThreadPool pool(threads, threads);
+        stealing = run([&pool](int priority, auto f) { pool.enqueue(priority, f); }, producers, tasks);
+    }
+    {
+        ThreadPool pool(threads, threads);
+        posted = run([&pool](int priority, auto f) { pool.post(priority, f); }, producers, tasks);
+    }
+
+    std::cout << std::fixed << std::setprecision(0)
+              << "priority_queue + mutex:  " << legacy << " tasks/s" << std::endl
+              << "work stealing, enqueue:  " << stealing << " tasks/s" << std::endl
+              << "work stealing, post:     " << posted << " tasks/s" << std::endl
+              << std::setprecision(2) << "speedup: " << stealing / legacy << "x (enqueue), "
+              << posted / legacy << "x (post)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,208 @@
+// Компилятор шаблонов: превращает .html шаблоны в C++ функции рендера,
+// которые регистрируются в TemplateEngine под именем файла.
+//
+// ./flaskcpp_tc -o templates.cpp index.html article.html ...
+
+#include <FlaskCpp/TemplateEngine.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+
+namespace {
+
+using Node = TemplateEngine::Node;
+
+// Строковый литерал C++; длинный текст разбивается по строкам шаблона
+std::string literal(const std::string& s)
+{
+    std::string out = "\"";
+    for (unsigned char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\t': out += "\\t"; break;
+        case '\r': out += "\\r"; break;
+        case '\n': out += "\\n\"\n    \""; break;
+        default:
+            if (c < 0x20 || c == 0x7f) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\%03o", c);
+                out += buf;
+            } else {
+                out += (char)c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+const char* filterName(Node::Filter filter)
+{
+    switch (filter) {
+    case Node::UPPER: return "Node::UPPER";
+    case Node::LOWER: return "Node::LOWER";
+    case Node::ESCAPE: return "Node::ESCAPE";
+    default: return "Node::NONE";
+    }
+}
+
+class Generator {
+public:
+    explicit Generator(std::string prefix) : prefix(std::move(prefix)) {}
+
+    // Генерирует функцию шаблона; возвращает её имя
+    std::string generate(const std::vector<Node>& nodes)
+    {
+        std::string name = prefix + "_f" + std::to_string(functions.size());
+        functions.emplace_back();
+        size_t index = functions.size() - 1;
+
+        std::ostringstream body;
+        body << "void " << name << "(RenderContext& ctx)\n{\n";
+        emit(nodes, body, 1);
+        body << "}\n";
+        functions[index] = body.str();
+        return name;
+    }
+
+    std::string code() const
+    {
+        std::ostringstream out;
+        out << names.str();
+        for (size_t i = 0; i < functions.size(); ++i) {
+            out << "void " << prefix << "_f" << i << "(RenderContext& ctx);\n";
+        }
+        out << "\n";
+        for (const auto& f : functions) out << f << "\n";
+        return out.str();
+    }
+
+private:
+    std::string prefix;
+    std::vector<std::string> functions;
+    std::ostringstream names;
+    std::map<std::string, std::string> nameIds;
+
+    // Имена переменных, шаблонов и блоков — статические std::string, чтобы не создавать их при рендере
+    std::string nameRef(const std::string& value)
+    {
+        auto it = nameIds.find(value);
+        if (it != nameIds.end()) return it->second;
+        std::string id = prefix + "_n" + std::to_string(nameIds.size());
+        names << "const std::string " << id << "(" << literal(value) << ");\n";
+        nameIds.emplace(value, id);
+        return id;
+    }
+
+    void emit(const std::vector<Node>& nodes, std::ostringstream& out, int depth)
+    {
+        std::string indent(depth * 4, ' ');
+        for (const Node& node : nodes) {
+            switch (node.type) {
+            case Node::TEXT:
+                out << indent << "ctx.text(" << literal(node.text) << ", " << node.text.size() << ");\n";
+                break;
+            case Node::VAR:
+                out << indent << "ctx.variable(" << nameRef(node.text) << ", " << filterName(node.filter) << ");\n";
+                break;
+            case Node::IF:
+                out << indent << "if (ctx.condition(" << nameRef(node.text) << ")) {\n";
+                emit(node.children, out, depth + 1);
+                if (!node.elseChildren.empty()) {
+                    out << indent << "} else {\n";
+                    emit(node.elseChildren, out, depth + 1);
+                }
+                out << indent << "}\n";
+                break;
+            case Node::FOR: {
+                std::string list = nameRef(node.text), var = nameRef(node.loopVar);
+                std::string body = generate(node.children);
+                out << indent << "ctx.loop(" << list << ", " << var << ", " << body << ");\n";
+                break;
+            }
+            case Node::INCLUDE:
+                out << indent << "ctx.include(" << nameRef(node.text) << ");\n";
+                break;
+            case Node::BLOCK: {
+                std::string name = nameRef(node.text);
+                std::string body = generate(node.children);
+                out << indent << "ctx.block(" << name << ", " << body << ");\n";
+                break;
+            }
+            }
+        }
+    }
+};
+
+bool readFile(const std::string& path, std::string& content)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    content = ss.str();
+    return true;
+}
+
+std::string baseName(const std::string& path)
+{
+    size_t pos = path.find_last_of('/');
+    return pos == std::string::npos ? path : path.substr(pos + 1);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string outputPath;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) outputPath = argv[++i];
+        else inputs.push_back(arg);
+    }
+    if (outputPath.empty()) {
+        std::cerr << "usage: " << argv[0] << " -o output.cpp template.html..." << std::endl;
+        return 1;
+    }
+
+    std::ostringstream out;
+    out << "// Generated by flaskcpp_tc. Do not edit.\n"
+        << "#include <FlaskCpp/TemplateEngine.h>\n\n"
+        << "namespace {\n\n"
+        << "using RenderContext = TemplateEngine::RenderContext;\n"
+        << "using Node = TemplateEngine::Node;\n\n";
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        std::string content;
+        if (!readFile(inputs[i], content)) {
+            std::cerr << "flaskcpp_tc: can not read '" << inputs[i] << "'" << std::endl;
+            return 1;
+        }
+        std::string prefix = "t" + std::to_string(i);
+        std::string name = baseName(inputs[i]);
+
+        Generator generator(prefix);
+        std::string entry = generator.generate(TemplateEngine::compile(content)->nodes);
+
+        out << "// " << name << "\n"
+            << generator.code()
+            << "const char " << prefix << "_source[] = " << literal(content) << ";\n"
+            << "const bool " << prefix << "_registered = TemplateEngine::registerCompiled("
+            << literal(name) << ", " << prefix << "_source, sizeof(" << prefix << "_source) - 1, "
+            << entry << ");\n\n";
+    }
+    out << "} // namespace\n";
+
+    // Не перезаписываем файл без изменений, чтобы не пересобирать цель
+    std::string code = out.str(), previous;
+    if (readFile(outputPath, previous) && previous == code) return 0;
+    std::ofstream file(outputPath, std::ios::binary);
+    if (!file) {
+        std::cerr << "flaskcpp_tc: can not write '" << outputPath << "'" << std::endl;
+        return 1;
+    }
+    file << code;
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "FlaskCpp/utils/compress.h"
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <zlib.h>
+
+namespace flaskcpp
+{
+
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+static bool equalsIgnoreCase(std::string_view a, const char* b)
+{
+    size_t n = strlen(b);
+    return a.size() == n && strncasecmp(a.data(), b, n) == 0;
+}
+
+ContentEncoding negotiateEncoding(std::string_view acceptEncoding)
+{
+    // -1 表示没有出现
+    double gzip = -1, deflate = -1, any = -1;
+    size_t pos = 0;
+    while (pos < acceptEncoding.size()) {
+        size_t comma = acceptEncoding.find(',', pos);
+        if (comma == std::string_view::npos) comma = acceptEncoding.size();
+        std::string_view item = acceptEncoding.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        double q = 1;
+        size_t semi = item.find(';');
+        if (semi != std::string_view::npos) {
+            std::string_view param = trim(item.substr(semi + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                q = std::atof(std::string(param.substr(2)).c_str());
+            }
+            item = item.substr(0, semi);
+        }
+        item = trim(item);
+        if (equalsIgnoreCase(item, "gzip") || equalsIgnoreCase(item, "x-gzip")) gzip = q;
+        else if (equalsIgnoreCase(item, "deflate")) deflate = q;
+        else if (item == "*") any = q;
+    }
+    if (gzip < 0) gzip = any;
+    if (deflate < 0) deflate = any;
+
+    if (gzip > 0 && gzip >= deflate) return ENCODING_GZIP;
+    if (deflate > 0) return ENCODING_DEFLATE;
+    return ENCODING_IDENTITY;
+}
+
+const char* encodingName(ContentEncoding encoding)
+{
+    switch (encoding) {
+    case ENCODING_GZIP: return "gzip";
+    case ENCODING_DEFLATE: return "deflate";
+    default: return "";
+    }
+}
+
+bool isCompressibleType(std::string_view contentType)
+{
+    size_t semi = contentType.find(';');
+    std::string_view type = trim(contentType.substr(0, semi));
+    if (type.size() > 5 && strncasecmp(type.data(), "text/", 5) == 0) return true;
+
+    static const char* types[] = {
+        "application/json", "application/javascript", "application/x-javascript",
+        "application/xml", "application/xhtml+xml", "image/svg+xml"
+    };
+    for (const char* t : types) {
+        if (equalsIgnoreCase(type, t)) return true;
+    }
+    auto endsWith = [&](const char* suffix) {
+        size_t n = strlen(suffix);
+        return type.size() > n && strncasecmp(type.data() + type.size() - n, suffix, n) == 0;
+    };
+    return endsWith("+json") || endsWith("+xml");
+}
+
+bool compress(std::string_view data, std::string& out, ContentEncoding encoding, int level)
+{
+    if (encoding == ENCODING_IDENTITY) return false;
+
+    z_stream zs = {};
+    // windowBits 16+15 生成 gzip 格式，15 生成 HTTP deflate 使用的 zlib 格式
+    int windowBits = encoding == ENCODING_GZIP ? 16 + MAX_WBITS : MAX_WBITS;
+    if (level < 1 || level > 9) level = Z_DEFAULT_COMPRESSION;
+    if (deflateInit2(&zs, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+
+    out.resize(deflateBound(&zs, data.size()));
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = data.size();
+    zs.next_out = (Bytef*)&out[0];
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+}
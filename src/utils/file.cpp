@@ -1,5 +1,12 @@
 #include "FlaskCpp/utils/file.h"
+#include "FlaskCpp/utils/responseWriter.h"
 #include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <cstring>
@@ -51,6 +58,7 @@ void FileHandler::init(std::string path, std::string file_name, bool as_attachme
     this->path = path;
     this->file_name = file_name;
     this->as_attachment = as_attachment;
+    content_encoding.clear();
     if (!this->file_name.size())
     {
         int k = -1;
@@ -87,85 +95,78 @@ void FileHandler::setFileData(std::vector<char> data)
     this->file_data = data;
 }
 
+void FileHandler::setEncoded(const std::string& encoded_path, const std::string& encoding)
+{
+    closeFileIfOpened(file);
+    path = encoded_path;
+    content_encoding = encoding;
+}
+
 std::string FileHandler::generateHeader(const std::vector<std::pair<std::string, std::string>>& extra_headers)
 {
-    std::ostringstream response;
+    std::string response;
+    response.reserve(256);
+    ResponseWriter writer(response);
     bool no_partial = start_ < 0 && end_ < 0;
-    if (no_partial)
+    writer.status(no_partial ? 200 : 206)
+          .contentType(content_type);
+
+    // Размер данных в памяти или файла на диске
+    int64_t total = 0;
+    if (!file_data.empty())
     {
-        response << "HTTP/1.1 200 OK" << "\r\n";
+        total = file_data.size();
+        etag_ = contentETag(std::string_view(file_data.data(), file_data.size()));
+        last_modified_ = 0;
     }
     else
     {
-        response << "HTTP/1.1 206 Partial Content" << "\r\n";
-        
-    }
-    
-    response << "Content-Type: " << content_type;
-
-    // Добавляем charset=utf-8 для текстовых типов контента
-    if (content_type.find("text/") != std::string::npos || content_type.find("application/json") != std::string::npos) {
-        response << "; charset=utf-8";
+        struct stat buffer;
+        if (stat(path.c_str(), &buffer) != 0) 
+        {
+            return "";
+        }
+        total = buffer.st_size;
+        etag_ = fileETag(buffer);
+        last_modified_ = buffer.st_mtime;
     }
-    response << "\r\n";
 
-    if (!file_data.empty())
+    if (no_partial)
     {
-        if (no_partial)
-        {
-            response << "Content-Length: " << file_data.size() << "\r\n";
-        }
-        else
-        {
-            if (end_ >= file_data.size())
-            {
-                end_ = file_data.size() - 1;
-                if (start_ > end_) return "";
-            }
-            response << "Accept-Ranges: bytes\r\n";
-            response << "Content-Length: " << (end_>0?end_:(file_data.size()-1)) - start_ + 1 << "\r\n";
-            response << "Content-Range: " << start_ << "-" << (end_>0?end_:(file_data.size()-1)) << "/" << file_data.size() << "\r\n";
-        }
+        writer.contentLength(total);
     }
     else
     {
-        struct stat buffer;
-        if (stat(path.c_str(), &buffer) == 0) 
+        if (end_ >= total)
         {
-            if (no_partial)
-            {
-                response << "Content-Length: " << buffer.st_size << "\r\n";
-            }
-            else
-            {
-                if (end_ >= buffer.st_size)
-                {
-                    end_ = buffer.st_size - 1;
-                    if (start_ > end_) return "";
-                }
-                response << "Accept-Ranges: bytes\r\n";
-                response << "Content-Length: " << (end_>0?end_:(buffer.st_size-1)) - start_ + 1 << "\r\n";
-                response << "Content-Range: " << start_ << "-" << (end_>0?end_:(buffer.st_size-1)) << "/" << buffer.st_size << "\r\n";
-            }
-        }
-        else
-        {
-            return "";
+            end_ = total - 1;
+            if (start_ > end_) return "";
         }
+        int64_t last = end_ > 0 ? end_ : total - 1;
+        std::string range = "bytes " + std::to_string(start_) + "-" + std::to_string(last) + "/" + std::to_string(total);
+        writer.header("Accept-Ranges", "bytes")
+              .contentLength(last - start_ + 1)
+              .header("Content-Range", range);
     }
 
     auto fileExtra = genFileExtraSettings(file_name, as_attachment);
-    response << fileExtra.first << ": " << fileExtra.second << "\r\n";
-
-    // Добавление дополнительных заголовков, включая несколько Set-Cookie
-    for (const auto& header : extra_headers) {
-        if (header.first.empty()) continue;
-        response << header.first << ": " << header.second << "\r\n";
+    writer.header(fileExtra.first, fileExtra.second)
+          .header("ETag", etag_);
+    if (last_modified_ > 0)
+    {
+        writer.header("Last-Modified", httpDate(last_modified_));
+    }
+    if (!content_encoding.empty())
+    {
+        writer.header("Content-Encoding", content_encoding)
+              .header("Vary", "Accept-Encoding");
     }
 
-    response << "Connection: close\r\n\r\n";
+    // Добавление дополнительных заголовков, включая несколько Set-Cookie
+    writer.headers(extra_headers)
+          .endHeaders();
 
-    return response.str();
+    return response;
 }
 
 
@@ -261,6 +262,65 @@ size_t FileHandler::read(std::vector<char>& data)
 }
 
 
+bool FileHandler::appendTo(ResponseChain& chain)
+{
+    int64_t size = 0;
+    if (!file_data.empty())
+    {
+        size = file_data.size();
+    }
+    else
+    {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) return false;
+        size = info.st_size;
+    }
+    if (!size) return true;
+
+    int64_t start = start_ > 0 ? start_ : 0;
+    int64_t end = (end_ > 0 && end_ < size) ? end_ : size - 1;
+    if (start > end) return false;
+
+    if (!file_data.empty())
+    {
+        chain.add(std::string_view(file_data.data() + start, end - start + 1));
+    }
+    else
+    {
+        chain.addFile(path, start, end - start + 1);
+    }
+    return true;
+}
+
+bool sendFileRange(int socket, const std::string& path, size_t offset, size_t count)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    off_t off = offset;
+    size_t remaining = count;
+    bool success = true;
+    while (remaining > 0) {
+        ssize_t n = sendfile(socket, fd, &off, std::min<size_t>(remaining, 1 << 30));
+        if (n > 0) {
+            remaining -= n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // socket缓冲区已满，等待可写
+            pollfd pfd = {socket, POLLOUT, 0};
+            if (poll(&pfd, 1, 30000) > 0) continue;
+        }
+        // 出错，或者文件在发送过程中被截断
+        success = false;
+        break;
+    }
+    close(fd);
+    return success;
+}
+
+
 static inline bool isdir(std::string path) 
 {
     struct stat info;
@@ -347,15 +407,51 @@ std::string save_file(const RequestData::File& file, const std::string& path, bo
         return "file already exist!";
     }
 
+    if (file.path.empty() || !file.temp || file.temp->path.empty())
+    {
+        return "no file data";
+    }
+
     create_directory_recursive(p, true);
 
-    std::ofstream f(p, std::ios::binary);
-    if (!f) {
+    // 先以0666创建目标文件，由内核按当前 umask 决定权限，同时占住文件名
+    int out = open(p.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (out < 0) {
         std::cerr << "can not open: " << p << std::endl;
         return "can not open: " + p;
     }
-    f.write(file.data.data(), file.data.size());
-    f.close();
+
+    // 临时文件由 mkostemp 以0600创建，改为目标文件的权限后在同一个文件系统上直接移动覆盖
+    struct stat st;
+    if (fstat(out, &st) == 0 && fchmod(file.fd, st.st_mode & 07777) == 0 &&
+        rename(file.temp->path.c_str(), p.c_str()) == 0)
+    {
+        close(out);
+        file.temp->path.clear();
+        return "";
+    }
+    if (errno != EXDEV)
+    {
+        close(out);
+        unlink(p.c_str());
+        std::cerr << "can not move to: " << p << std::endl;
+        return "can not move to: " + p;
+    }
+
+    // 跨文件系统，在内核中复制到已创建的目标文件
+    off_t offset = 0;
+    while ((size_t)offset < file.size)
+    {
+        ssize_t n = sendfile(out, file.fd, &offset, file.size - offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0)
+        {
+            close(out);
+            unlink(p.c_str());
+            return "can not write: " + p;
+        }
+    }
+    close(out);
     return "";
 }
 
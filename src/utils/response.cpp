@@ -2,39 +2,40 @@
 #define FLASKCPP_UTILS_RESPONSE_CPP
 
 #include "FlaskCpp/utils/response.h"
+#include "FlaskCpp/utils/responseWriter.h"
 #include "FlaskCpp/FlaskTypes.h"
 #include <cstring>
+#include <strings.h>
 #include <cstdint>
 
 namespace flaskcpp
 {
 
+// 内存中的主体自动生成 ETag，条件请求可以返回304；用户已经指定 ETag 时使用用户的。
+// 设置 cookie 的响应不生成，304 不会带上 Set-Cookie
+static void addETag(Response& resp, std::vector<std::pair<std::string, std::string>>& extra_headers)
+{
+    for (const auto& h : extra_headers)
+    {
+        if (strcasecmp(h.first.c_str(), "Set-Cookie") == 0) return;
+        if (strcasecmp(h.first.c_str(), "ETag") == 0)
+        {
+            resp.etag = h.second;
+            return;
+        }
+    }
+    resp.etag = contentETag(resp.body);
+    extra_headers.emplace_back("ETag", resp.etag);
+}
+
 Response send_error(std::string text, int type, 
                     std::vector<std::pair<std::string, std::string>> extra_headers)
 {
     Response resp;
-    type = HttpStatusMap.find(type)!=HttpStatusMap.end()?type:500;
+    type = statusLine(type).empty() ? 500 : type;
     resp.type = type;
-    std::string content_type = getFileTypeString(FLASK_FILE_TEXT_HTML, "");
-    std::ostringstream oss;
-    
-    oss << "HTTP/1.1 " << type << " " 
-        << HttpStatusMap.at(type) << "\r\n";
-    
-    oss << "Content-Type: " << content_type;
-    oss << "; charset=utf-8\r\n";
-    oss << "Content-Length: " << text.size() << "\r\n";
-    for (const auto& header : extra_headers) {
-        if (header.first.empty()) continue;
-        oss << header.first << ": " << header.second << "\r\n";
-    }
-    oss << "Connection: close\r\n\r\n";
-
-    oss << text;
-
-    resp.text = oss.str();
-
-    // std::cout << resp.text << std::endl;
+    resp.text = ResponseWriter::buildHeader(type, getFileTypeString(FLASK_FILE_TEXT_HTML, ""), text.size(), extra_headers);
+    resp.body = std::move(text);
     return resp;
 }
 
@@ -42,28 +43,11 @@ Response send_error(JsonGenerator& json, int type,
                     std::vector<std::pair<std::string, std::string>> extra_headers)
 {
     Response resp;
-    type = HttpStatusMap.find(type)!=HttpStatusMap.end()?type:500;
-    
+    type = statusLine(type).empty() ? 500 : type;
     resp.type = type;
-    std::string content_type = getFileTypeString(FLASK_FILE_APP_JSON, "");
-    std::ostringstream oss;
-    oss << "HTTP/1.1 " << type << " " 
-        << HttpStatusMap.at(type) << "\r\n";
-
-    oss << "Content-Type: " << content_type;
-    oss << "; charset=utf-8\r\n";
-    oss << "Content-Length: " << json.toString().size() << "\r\n";
-    for (const auto& header : extra_headers) {
-        if (header.first.empty()) continue;
-        oss << header.first << ": " << header.second << "\r\n";
-    }
-    oss << "Connection: close\r\n\r\n";
-
-    oss << json.toString();
-
-    resp.text = oss.str();
-
-    // std::cout << resp.text << std::endl;
+    // json 只生成一次
+    resp.body = json.toString();
+    resp.text = ResponseWriter::buildHeader(type, getFileTypeString(FLASK_FILE_APP_JSON, ""), resp.body.size(), extra_headers);
     return resp;
 }
 
@@ -73,7 +57,7 @@ Response send_text(std::string text,
 {
     Response resp;
     resp.type = RESP_TYPE_TEXT;
-    std::string content_type = getFileTypeString(FLASK_FILE_TEXT_PLAIN, "");
+    int file_type = FLASK_FILE_TEXT_PLAIN;
 
     if (text.find("<!DOCTYPE html>") < 2 || (text.find("<head") != text.npos && 
                                               text.find("</head>")!= text.npos && 
@@ -82,34 +66,16 @@ Response send_text(std::string text,
                                               text.find("<html") != text.npos && 
                                               text.find("</html>") != text.npos))
     {
-        content_type = getFileTypeString(FLASK_FILE_TEXT_HTML, "");
+        file_type = FLASK_FILE_TEXT_HTML;
     }
-    else if (text[0] == '{' && text[text.size()-1] == '}')
+    else if (!text.empty() && text[0] == '{' && text[text.size()-1] == '}')
     {
-        content_type = getFileTypeString(FLASK_FILE_APP_JSON, "");
-    }
-    
-    std::ostringstream oss;
-    oss << "HTTP/1.1 200 OK" << "\r\n";
-    oss << "Content-Type: " << content_type;
-    if (content_type.find("text/") != std::string::npos || content_type.find("application/json") != std::string::npos) {
-        oss << "; charset=utf-8";
-    }
-    oss << "\r\n";
-
-    oss << "Content-Length: " << text.size() << "\r\n";
-
-    for (const auto& header : extra_headers) {
-        if (header.first.empty()) continue;
-        oss << header.first << ": " << header.second << "\r\n";
+        file_type = FLASK_FILE_APP_JSON;
     }
 
-    oss << "Connection: close\r\n\r\n";
-
-    oss << text;
-
-    resp.text = oss.str();
-
+    resp.body = std::move(text);
+    addETag(resp, extra_headers);
+    resp.text = ResponseWriter::buildHeader(200, getFileTypeString(file_type, ""), resp.body.size(), extra_headers);
     return resp;
 }
 
@@ -118,31 +84,44 @@ Response send_text(JsonGenerator& json,
 {
     Response resp;
     resp.type = RESP_TYPE_JSON;
-    std::string content_type = getFileTypeString(FLASK_FILE_APP_JSON, "");
-    std::ostringstream oss;
-    oss << "HTTP/1.1 200 OK" << "\r\n";
-    oss << "Content-Type: " << content_type;
-    if (content_type.find("text/") != std::string::npos || content_type.find("application/json") != std::string::npos) {
-        oss << "; charset=utf-8";
-    }
-    oss << "\r\n";
-
-    oss << "Content-Length: " << json.toString().size() << "\r\n";
+    // json 只生成一次
+    resp.body = json.toString();
+    addETag(resp, extra_headers);
+    resp.text = ResponseWriter::buildHeader(200, getFileTypeString(FLASK_FILE_APP_JSON, ""), resp.body.size(), extra_headers);
+    return resp;
+}
 
-    for (const auto& header : extra_headers) {
-        if (header.first.empty()) continue;
-        oss << header.first << ": " << header.second << "\r\n";
+Response send_stream(StreamProducer producer, std::string content_type,
+                     std::vector<std::pair<std::string, std::string>> extra_headers)
+{
+    Response resp;
+    resp.type = RESP_TYPE_STREAM;
+    resp.stream = std::move(producer);
+    if (content_type.empty())
+    {
+        content_type = getFileTypeString(FLASK_FILE_TEXT_HTML, "");
     }
 
-    oss << "Connection: close\r\n\r\n";
-
-    oss << json.toString();
-
-    resp.text = oss.str();
-
+    ResponseWriter(resp.text).status(200)
+                             .contentType(content_type)
+                             .header("Transfer-Encoding", "chunked")
+                             .headers(extra_headers)
+                             .endHeaders();
     return resp;
 }
 
+Response send_generator(StreamGenerator generator, std::string content_type,
+                        std::vector<std::pair<std::string, std::string>> extra_headers)
+{
+    return send_stream([generator](const StreamWriter& write) {
+        std::string chunk;
+        while (generator(chunk))
+        {
+            if (!chunk.empty() && !write(chunk.data(), chunk.size())) return;
+            chunk.clear();
+        }
+    }, std::move(content_type), std::move(extra_headers));
+}
 
 Response send_file(std::string file_path, std::string file_name, bool as_attachment, 
                    std::vector<std::pair<std::string, std::string>> extra_headers)
@@ -0,0 +1,316 @@
+#include "FlaskCpp/utils/responseWriter.h"
+#include "FlaskCpp/utils/response.h"
+#include "FlaskCpp/utils/file.h"
+#include <charconv>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace flaskcpp
+{
+
+static const int MIN_STATUS = 100;
+static const int MAX_STATUS = 599;
+
+const std::string& statusLine(int status)
+{
+    // 第一次调用时由 HttpStatusMap 生成全部状态行
+    static const std::vector<std::string> lines = [] {
+        std::vector<std::string> v(MAX_STATUS - MIN_STATUS + 1);
+        for (const auto& item : HttpStatusMap) {
+            if (item.first < MIN_STATUS || item.first > MAX_STATUS) continue;
+            v[item.first - MIN_STATUS] = "HTTP/1.1 " + std::to_string(item.first) + " " + item.second + "\r\n";
+        }
+        return v;
+    }();
+    static const std::string empty;
+    if (status < MIN_STATUS || status > MAX_STATUS) return empty;
+    return lines[status - MIN_STATUS];
+}
+
+const std::string& dateHeader()
+{
+    thread_local std::string header;
+    thread_local std::time_t cachedSecond = 0;
+
+    std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    if (now != cachedSecond) {
+        cachedSecond = now;
+        std::tm tm;
+        gmtime_r(&now, &tm);
+        char buf[64];
+        size_t n = std::strftime(buf, sizeof(buf), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        header.assign(buf, n);
+    }
+    return header;
+}
+
+std::string httpDate(std::time_t t)
+{
+    std::tm tm;
+    gmtime_r(&t, &tm);
+    char buf[64];
+    size_t n = std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return std::string(buf, n);
+}
+
+std::time_t parseHttpDate(std::string_view value)
+{
+    std::string str(value);
+    std::tm tm = {};
+    const char* end = strptime(str.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end) return -1;
+    return timegm(&tm);
+}
+
+std::string fileETag(const struct stat& info)
+{
+    char buf[80];
+    int n = snprintf(buf, sizeof(buf), "\"%llx-%llx-%llx\"",
+                     (unsigned long long)info.st_ino, (unsigned long long)info.st_size,
+                     (unsigned long long)info.st_mtim.tv_sec * 1000000000ull + info.st_mtim.tv_nsec);
+    return std::string(buf, n);
+}
+
+std::string contentETag(std::string_view body)
+{
+    // FNV-1a 64
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : body) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    char buf[40];
+    int n = snprintf(buf, sizeof(buf), "\"%llx-%zx\"", (unsigned long long)hash, body.size());
+    return std::string(buf, n);
+}
+
+// 弱比较：忽略 W/ 前缀
+static std::string_view opaqueTag(std::string_view tag)
+{
+    if (tag.size() >= 2 && tag[0] == 'W' && tag[1] == '/') tag.remove_prefix(2);
+    return tag;
+}
+
+bool isNotModified(std::string_view ifNoneMatch, std::string_view ifModifiedSince,
+                   std::string_view etag, std::time_t lastModified)
+{
+    if (!ifNoneMatch.empty()) {
+        if (etag.empty()) return false;
+        std::string_view target = opaqueTag(etag);
+        size_t pos = 0;
+        while (pos < ifNoneMatch.size()) {
+            size_t comma = ifNoneMatch.find(',', pos);
+            if (comma == std::string_view::npos) comma = ifNoneMatch.size();
+            std::string_view tag = ifNoneMatch.substr(pos, comma - pos);
+            while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) tag.remove_prefix(1);
+            while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) tag.remove_suffix(1);
+            if (tag == "*" || opaqueTag(tag) == target) return true;
+            pos = comma + 1;
+        }
+        return false;
+    }
+    if (!ifModifiedSince.empty() && lastModified > 0) {
+        std::time_t since = parseHttpDate(ifModifiedSince);
+        return since >= 0 && lastModified <= since;
+    }
+    return false;
+}
+
+void ResponseWriter::appendNumber(uint64_t value)
+{
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, res.ptr - buf);
+}
+
+ResponseWriter& ResponseWriter::status(int status)
+{
+    const std::string& line = statusLine(status);
+    out += line.empty() ? statusLine(500) : line;
+    out += dateHeader();
+    return *this;
+}
+
+ResponseWriter& ResponseWriter::header(std::string_view name, std::string_view value)
+{
+    if (name.empty()) return *this;
+    out.append(name);
+    out += ": ";
+    out.append(value);
+    out += "\r\n";
+    return *this;
+}
+
+ResponseWriter& ResponseWriter::header(std::string_view name, uint64_t value)
+{
+    out.append(name);
+    out += ": ";
+    appendNumber(value);
+    out += "\r\n";
+    return *this;
+}
+
+ResponseWriter& ResponseWriter::contentType(std::string_view type)
+{
+    out += "Content-Type: ";
+    out.append(type);
+    if (type.find("text/") != std::string_view::npos || type.find("application/json") != std::string_view::npos) {
+        if (type.find("charset") == std::string_view::npos) out += "; charset=utf-8";
+    }
+    out += "\r\n";
+    return *this;
+}
+
+ResponseWriter& ResponseWriter::contentLength(uint64_t length)
+{
+    return header("Content-Length", length);
+}
+
+ResponseWriter& ResponseWriter::headers(const std::vector<std::pair<std::string, std::string>>& extra_headers)
+{
+    for (const auto& h : extra_headers) {
+        header(h.first, h.second);
+    }
+    return *this;
+}
+
+ResponseWriter& ResponseWriter::endHeaders(size_t bodySize)
+{
+    out += "\r\n";
+    if (bodySize) out.reserve(out.size() + bodySize);
+    return *this;
+}
+
+ResponseWriter& ResponseWriter::body(std::string_view data)
+{
+    out.append(data);
+    return *this;
+}
+
+std::string ResponseWriter::build(int status, std::string_view content_type, std::string_view body,
+                                  const std::vector<std::pair<std::string, std::string>>& extra_headers)
+{
+    std::string out;
+    out.reserve(256 + body.size());
+    ResponseWriter(out).status(status)
+                       .contentType(content_type)
+                       .contentLength(body.size())
+                       .headers(extra_headers)
+                       .endHeaders()
+                       .body(body);
+    return out;
+}
+
+std::string ResponseWriter::buildNotModified(std::string_view etag, std::time_t lastModified)
+{
+    std::string out;
+    out.reserve(192);
+    ResponseWriter writer(out);
+    writer.status(304);
+    if (!etag.empty()) writer.header("ETag", etag);
+    if (lastModified > 0) writer.header("Last-Modified", httpDate(lastModified));
+    writer.endHeaders();
+    return out;
+}
+
+std::string ResponseWriter::buildHeader(int status, std::string_view content_type, size_t body_size,
+                                        const std::vector<std::pair<std::string, std::string>>& extra_headers)
+{
+    std::string out;
+    out.reserve(256);
+    ResponseWriter(out).status(status)
+                       .contentType(content_type)
+                       .contentLength(body_size)
+                       .headers(extra_headers)
+                       .endHeaders();
+    return out;
+}
+
+void ResponseChain::add(std::string_view data)
+{
+    if (data.empty()) return;
+    Segment seg;
+    seg.data = data.data();
+    seg.size = data.size();
+    segments.push_back(std::move(seg));
+}
+
+void ResponseChain::add(std::string&& data)
+{
+    if (data.empty()) return;
+    owned.push_back(std::move(data));
+    add(std::string_view(owned.back()));
+}
+
+void ResponseChain::addFile(std::string path, uint64_t offset, uint64_t count)
+{
+    if (!count) return;
+    Segment seg;
+    seg.size = count;
+    seg.path = std::move(path);
+    seg.offset = offset;
+    segments.push_back(std::move(seg));
+}
+
+uint64_t ResponseChain::size() const
+{
+    uint64_t total = 0;
+    for (const auto& seg : segments) total += seg.size;
+    return total;
+}
+
+bool ResponseChain::sendTo(int socket, int timeout_ms)
+{
+    static const size_t MAX_IOV = 64;
+    size_t i = 0;
+    while (i < segments.size()) {
+        if (!segments[i].path.empty()) {
+            if (!sendFileRange(socket, segments[i].path, segments[i].offset, segments[i].size)) return false;
+            ++i;
+            continue;
+        }
+
+        // 连续的内存块一次发送
+        iovec iov[MAX_IOV];
+        size_t count = 0;
+        while (i + count < segments.size() && count < MAX_IOV && segments[i + count].path.empty()) {
+            iov[count].iov_base = (void*)segments[i + count].data;
+            iov[count].iov_len = segments[i + count].size;
+            ++count;
+        }
+        msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        // 后面还有数据（例如文件）时提示内核合并成完整的报文
+        int flags = MSG_NOSIGNAL | (i + count < segments.size() ? MSG_MORE : 0);
+        ssize_t n = sendmsg(socket, &msg, flags);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                pollfd pfd = {socket, POLLOUT, 0};
+                if (poll(&pfd, 1, timeout_ms) <= 0) return false;
+                continue;
+            }
+            return false;
+        }
+
+        // 跳过已经完整发送的块，部分发送的块从断点继续
+        size_t sent = n;
+        while (sent > 0 && sent >= segments[i].size) {
+            sent -= segments[i].size;
+            ++i;
+        }
+        if (sent > 0) {
+            segments[i].data += sent;
+            segments[i].size -= sent;
+        }
+    }
+    return true;
+}
+
+}
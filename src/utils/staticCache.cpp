@@ -0,0 +1,303 @@
+#include "FlaskCpp/utils/staticCache.h"
+#include "FlaskCpp/utils/responseWriter.h"
+#include <chrono>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace flaskcpp
+{
+
+static int64_t nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const char* contentTypeOf(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return "text/plain";
+    std::string ext = path.substr(dot);
+    if (ext == ".html") return "text/html";
+    if (ext == ".css") return "text/css";
+    if (ext == ".js") return "application/javascript";
+    if (ext == ".json") return "application/json";
+    if (ext == ".png") return "image/png";
+    if (ext == ".jpg" || ext == ".jpeg") return "image/jpeg";
+    if (ext == ".gif") return "image/gif";
+    return "text/plain";
+}
+
+static bool sameFile(uint64_t size, const timespec& mtime, dev_t dev, ino_t ino, const struct stat& info)
+{
+    return dev == info.st_dev && ino == info.st_ino &&
+           size == (uint64_t)info.st_size &&
+           mtime.tv_sec == info.st_mtim.tv_sec &&
+           mtime.tv_nsec == info.st_mtim.tv_nsec;
+}
+
+static bool isRegularFile(const std::string& path, struct stat& info)
+{
+    return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+static bool readFile(int fd, std::string& buffer, size_t size)
+{
+    buffer.resize(size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, &buffer[done], size - done, done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    return done == size;
+}
+
+StaticCache::Entry::~Entry()
+{
+    if (mapped) munmap(mapped, size);
+}
+
+StaticCache::StaticCache(size_t maxBytes, size_t smallFileLimit, int checkIntervalMs)
+    : maxBytes(maxBytes), smallFileLimit(smallFileLimit), checkInterval(checkIntervalMs)
+{
+}
+
+StaticCache::EntryPtr StaticCache::lookup(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end()) return nullptr;
+    lru.splice(lru.begin(), lru, it->second);
+    return *it->second;
+}
+
+bool StaticCache::validate(const EntryPtr& entry)
+{
+    int64_t now = nowMs();
+    if (now - entry->checkedMs.load(std::memory_order_relaxed) < checkInterval.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    struct stat info;
+    if (isRegularFile(entry->path, info) && sameFile(entry->fileSize, entry->mtime, entry->dev, entry->ino, info)) {
+        entry->checkedMs.store(now, std::memory_order_relaxed);
+        return true;
+    }
+    // 文件已修改或删除
+    erase(entry);
+    return false;
+}
+
+StaticCache::EntryPtr StaticCache::get(const std::string& path)
+{
+    EntryPtr entry = lookup(path);
+    if (entry && validate(entry)) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return entry;
+    }
+
+    struct stat info;
+    if (!isRegularFile(path, info)) return nullptr;
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    entry = load(path, path, info, contentTypeOf(path), nullptr);
+    if (entry && entry->cached) insert(entry);
+    return entry;
+}
+
+StaticCache::EntryPtr StaticCache::getEncoded(const std::string& path, ContentEncoding encoding,
+                                              const CompressionOptions& options)
+{
+    if (encoding == ENCODING_IDENTITY || options.level <= 0) return nullptr;
+    const char* contentType = contentTypeOf(path);
+    if (!isCompressibleType(contentType)) return nullptr;
+
+    std::string key = path + '\n' + encodingName(encoding);
+    EntryPtr entry = lookup(key);
+    if (entry && validate(entry)) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return entry;
+    }
+
+    struct stat info;
+    if (encoding == ENCODING_GZIP && isRegularFile(path + ".gz", info)) {
+        // 预先压缩的文件，内容可以用sendfile发送
+        misses.fetch_add(1, std::memory_order_relaxed);
+        entry = load(key, path + ".gz", info, contentType, "gzip");
+        if (entry && entry->cached) insert(entry);
+        return entry;
+    }
+
+    if (!isRegularFile(path, info) || (size_t)info.st_size < options.minSize) return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ((size_t)info.st_size > maxBytes) return nullptr;
+    }
+    misses.fetch_add(1, std::memory_order_relaxed);
+    entry = compressFile(key, path, info, encoding, options.level);
+    if (entry) insert(entry);
+    return entry;
+}
+
+StaticCache::EntryPtr StaticCache::load(const std::string& key, const std::string& path, const struct stat& info,
+                                        const char* contentType, const char* encoding)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->key = key;
+    entry->path = path;
+    entry->size = entry->fileSize = info.st_size;
+    entry->mtime = info.st_mtim;
+    entry->dev = info.st_dev;
+    entry->ino = info.st_ino;
+    entry->checkedMs.store(nowMs(), std::memory_order_relaxed);
+
+    entry->etag = fileETag(info);
+    ResponseWriter writer(entry->headers);
+    writer.header("Content-Type", contentType)
+          .contentLength(entry->size)
+          .header("ETag", entry->etag)
+          .header("Last-Modified", httpDate(info.st_mtime));
+    if (encoding) {
+        writer.header("Content-Encoding", encoding)
+              .header("Vary", "Accept-Encoding");
+    }
+
+    size_t small, budget;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        small = smallFileLimit;
+        budget = maxBytes;
+    }
+    // 超过内存预算的文件不缓存
+    if (entry->size == 0 || entry->size > budget) return entry;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+
+    if (entry->size <= small) {
+        if (readFile(fd, entry->buffer, entry->size)) {
+            entry->data = entry->buffer.data();
+            entry->cached = true;
+        }
+    } else {
+        void* p = mmap(nullptr, entry->size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            entry->mapped = p;
+            entry->data = static_cast<const char*>(p);
+            entry->cached = true;
+        }
+    }
+    close(fd);
+    return entry;
+}
+
+StaticCache::EntryPtr StaticCache::compressFile(const std::string& key, const std::string& path, const struct stat& info,
+                                                ContentEncoding encoding, int level)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    std::string content;
+    bool ok = readFile(fd, content, info.st_size);
+    close(fd);
+
+    auto entry = std::make_shared<Entry>();
+    if (!ok || !compress(content, entry->buffer, encoding, level)) return nullptr;
+    entry->key = key;
+    entry->path = path;
+    entry->size = entry->buffer.size();
+    entry->fileSize = info.st_size;
+    entry->mtime = info.st_mtim;
+    entry->dev = info.st_dev;
+    entry->ino = info.st_ino;
+    entry->data = entry->buffer.data();
+    entry->cached = true;
+    entry->checkedMs.store(nowMs(), std::memory_order_relaxed);
+
+    // 与未压缩的版本区分
+    std::string etag = fileETag(info);
+    entry->etag = etag.substr(0, etag.size() - 1) + "-" + encodingName(encoding) + "\"";
+    ResponseWriter(entry->headers).header("Content-Type", contentTypeOf(path))
+                                  .contentLength(entry->size)
+                                  .header("ETag", entry->etag)
+                                  .header("Last-Modified", httpDate(info.st_mtime))
+                                  .header("Content-Encoding", encodingName(encoding))
+                                  .header("Vary", "Accept-Encoding");
+    return entry;
+}
+
+void StaticCache::insert(const EntryPtr& entry)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(entry->key);
+    if (it != entries.end()) {
+        // 另一个线程同时加载了同一个文件
+        bytes -= (*it->second)->size;
+        lru.erase(it->second);
+        entries.erase(it);
+    }
+    lru.push_front(entry);
+    entries[entry->key] = lru.begin();
+    bytes += entry->size;
+    evict();
+}
+
+void StaticCache::erase(const EntryPtr& entry)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(entry->key);
+    if (it == entries.end() || *it->second != entry) return;
+    bytes -= entry->size;
+    lru.erase(it->second);
+    entries.erase(it);
+}
+
+void StaticCache::evict()
+{
+    // 正在发送的条目由 shared_ptr 保持，发送完成后才释放
+    while (bytes > maxBytes && !lru.empty()) {
+        const EntryPtr& last = lru.back();
+        bytes -= last->size;
+        entries.erase(last->key);
+        lru.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void StaticCache::setLimits(size_t maxBytes, size_t smallFileLimit)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->maxBytes = maxBytes;
+    this->smallFileLimit = smallFileLimit;
+    evict();
+}
+
+void StaticCache::setCheckInterval(int ms)
+{
+    checkInterval.store(ms, std::memory_order_relaxed);
+}
+
+void StaticCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    lru.clear();
+    bytes = 0;
+}
+
+StaticCache::Stats StaticCache::stats() const
+{
+    Stats s;
+    s.hits = hits.load(std::memory_order_relaxed);
+    s.misses = misses.load(std::memory_order_relaxed);
+    s.evictions = evictions.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex);
+    s.entries = entries.size();
+    s.bytes = bytes;
+    return s;
+}
+
+}
@@ -0,0 +1,206 @@
+// HttpParser 的单元测试：请求边界（Content-Length、chunked）必须和 RFC 9112 一致，
+// 否则前端代理和服务器对请求边界的理解不同，会导致请求走私
+#include "FlaskCpp/HttpParser.h"
+#include <cstdio>
+#include <string>
+#include <algorithm>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++failures; \
+        } \
+    } while (0)
+
+// 每次追加 step 字节后调用 parse()，直到请求完整或出错；
+// buffer 为解析后的缓冲区，fed 为已经追加的字节数
+static HttpParser::State parseInSteps(HttpParser& parser, const std::string& wire, size_t step,
+                                      std::string& buffer, size_t& fed)
+{
+    HttpParser::State state = parser.state();
+    for (fed = 0; fed < wire.size();) {
+        size_t n = std::min(step, wire.size() - fed);
+        buffer.append(wire, fed, n);
+        fed += n;
+        state = parser.parse(buffer);
+        if (state == HttpParser::STATE_COMPLETE || state == HttpParser::STATE_ERROR) break;
+    }
+    return state;
+}
+
+static HttpParser::State parseWhole(HttpParser& parser, const std::string& wire)
+{
+    std::string buffer;
+    size_t fed;
+    return parseInSteps(parser, wire, wire.size(), buffer, fed);
+}
+
+static void testContentLength()
+{
+    HttpParser parser;
+    std::string buffer = "POST /a HTTP/1.1\r\nContent-Length: 3\r\n\r\nabcGET /b HTTP/1.1\r\n\r\n";
+    CHECK(parser.parse(buffer) == HttpParser::STATE_COMPLETE);
+    CHECK(parser.body() == "abc");
+    CHECK(buffer.substr(parser.messageSize()) == "GET /b HTTP/1.1\r\n\r\n");
+
+    // 主体尚未完整到达
+    HttpParser partial;
+    buffer = "POST /a HTTP/1.1\r\nContent-Length: 10\r\n\r\nabc";
+    CHECK(partial.parse(buffer) == HttpParser::STATE_BODY);
+    CHECK(partial.bodyRemaining() == 10);
+}
+
+static void testDuplicateContentLength()
+{
+    // 相同的值可以重复
+    HttpParser same;
+    CHECK(parseWhole(same, "POST /a HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3\r\n\r\nabc") ==
+          HttpParser::STATE_COMPLETE);
+    HttpParser list;
+    CHECK(parseWhole(list, "POST /a HTTP/1.1\r\nContent-Length: 3, 3\r\n\r\nabc") == HttpParser::STATE_COMPLETE);
+    CHECK(list.contentLength() == 3);
+
+    // 不同的值必须拒绝，不能只使用第一个
+    HttpParser differ;
+    CHECK(parseWhole(differ, "POST /a HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 40\r\n\r\n"
+                             "abcGET /user/SMUGGLED HTTP/1.1\r\n\r\n") == HttpParser::STATE_ERROR);
+    HttpParser differList;
+    CHECK(parseWhole(differList, "POST /a HTTP/1.1\r\nContent-Length: 3, 40\r\n\r\nabc") == HttpParser::STATE_ERROR);
+    HttpParser caseInsensitive;
+    CHECK(parseWhole(caseInsensitive, "POST /a HTTP/1.1\r\nContent-Length: 3\r\ncontent-length: 4\r\n\r\nabcd") ==
+          HttpParser::STATE_ERROR);
+}
+
+static void testInvalidContentLength()
+{
+    const char* values[] = {
+        "18446744073709551616",     // SIZE_MAX + 1
+        "18446744073709551619",     // 回绕后为3
+        "99999999999999999999999",
+        "12x",
+        "-1",
+        "+3",
+        "0x10",
+        "",
+        "3,",
+    };
+    for (const char* value: values) {
+        HttpParser parser;
+        std::string wire = std::string("POST /a HTTP/1.1\r\nContent-Length: ") + value + "\r\n\r\nabc";
+        CHECK(parseWhole(parser, wire) == HttpParser::STATE_ERROR);
+    }
+
+    // SIZE_MAX 本身是合法的长度，但主体永远不会完整，messageSize() 不能回绕
+    HttpParser max;
+    std::string buffer = "POST /a HTTP/1.1\r\nContent-Length: 18446744073709551615\r\n\r\nabc";
+    CHECK(max.parse(buffer) == HttpParser::STATE_BODY);
+    CHECK(max.messageSize() == SIZE_MAX);
+}
+
+static void testChunked()
+{
+    std::string wire = "POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                       "3\r\nabc\r\n"
+                       "A;name=value\r\n0123456789\r\n"
+                       "1\nx\n"                         // 也接受单独的 LF
+                       "0\r\nX-Trailer: 1\r\n\r\n"
+                       "GET /b HTTP/1.1\r\n\r\n";
+    // 任意切分都得到相同的结果
+    for (size_t step = 1; step <= wire.size(); ++step) {
+        HttpParser parser;
+        std::string buffer;
+        size_t fed;
+        HttpParser::State state = parseInSteps(parser, wire, step, buffer, fed);
+        CHECK(state == HttpParser::STATE_COMPLETE);
+        if (state != HttpParser::STATE_COMPLETE) break;
+        CHECK(parser.body() == "abc0123456789x");
+        CHECK(parser.contentLength() == 14);
+        // 块头已经删除，请求之后的数据（pipelining 的下一个请求）保持不变
+        CHECK(buffer.substr(parser.messageSize()) + wire.substr(fed) == "GET /b HTTP/1.1\r\n\r\n");
+    }
+
+    // 大量小块（线性时间）
+    std::string many = "POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+    for (int i = 0; i < 100000; ++i) many += "1\r\nz\r\n";
+    many += "0\r\n\r\n";
+    HttpParser manyParser;
+    CHECK(parseWhole(manyParser, many) == HttpParser::STATE_COMPLETE);
+    CHECK(manyParser.body().size() == 100000);
+}
+
+static void testInvalidChunked()
+{
+    const char* bodies[] = {
+        "x\r\nabc\r\n0\r\n\r\n",                        // 长度不是十六进制
+        "\r\nabc\r\n0\r\n\r\n",                         // 没有长度
+        "3 x\r\nabc\r\n0\r\n\r\n",                      // 长度后面不是扩展
+        "3\r\nabcX\r\n0\r\n\r\n",                       // 块数据之后不是 CRLF
+        "10000000000000000\r\n",                        // 长度超出 size_t
+    };
+    for (const char* body: bodies) {
+        HttpParser parser;
+        std::string wire = std::string("POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n") + body;
+        CHECK(parseWhole(parser, wire) == HttpParser::STATE_ERROR);
+    }
+
+    // 最后一个编码不是 chunked 时无法确定边界
+    HttpParser gzip;
+    CHECK(parseWhole(gzip, "POST /a HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n") == HttpParser::STATE_ERROR);
+
+    // 过长的块头
+    HttpParser longLine;
+    std::string wire = "POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3;" +
+                       std::string(HttpParser::MAX_CHUNK_LINE + 1, 'e');
+    CHECK(parseWhole(longLine, wire) == HttpParser::STATE_ERROR);
+}
+
+static void testTransferEncodingWithLength()
+{
+    // chunked 优先，Content-Length 被忽略，但响应之后必须关闭连接
+    HttpParser both;
+    CHECK(parseWhole(both, "POST /a HTTP/1.1\r\nContent-Length: 40\r\nTransfer-Encoding: chunked\r\n\r\n"
+                           "3\r\nabc\r\n0\r\n\r\n") == HttpParser::STATE_COMPLETE);
+    CHECK(both.body() == "abc");
+    CHECK(both.mustClose());
+
+    HttpParser chunkedOnly;
+    CHECK(parseWhole(chunkedOnly, "POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n") ==
+          HttpParser::STATE_COMPLETE);
+    CHECK(!chunkedOnly.mustClose());
+
+    // reset() 之后不影响下一个请求
+    both.reset();
+    std::string buffer = "GET /b HTTP/1.1\r\n\r\n";
+    CHECK(both.parse(buffer) == HttpParser::STATE_COMPLETE);
+    CHECK(!both.mustClose());
+
+    // 多个 Transfer-Encoding 头时以最后一个编码为准
+    HttpParser split;
+    CHECK(parseWhole(split, "POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: gzip\r\n\r\n") ==
+          HttpParser::STATE_ERROR);
+
+    // HTTP/1.0 没有 Transfer-Encoding
+    HttpParser http10;
+    CHECK(parseWhole(http10, "POST /a HTTP/1.0\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n") ==
+          HttpParser::STATE_ERROR);
+}
+
+int main()
+{
+    testContentLength();
+    testDuplicateContentLength();
+    testInvalidContentLength();
+    testChunked();
+    testInvalidChunked();
+    testTransferEncodingWithLength();
+
+    if (failures) {
+        std::printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}